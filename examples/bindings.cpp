@@ -0,0 +1,74 @@
+#include <print>
+#include <chrono>
+#include <string>
+#include "termml.hpp"
+
+using namespace termml;
+
+// Updates a fixed dashboard through placeholders, the way a 30 Hz status screen would,
+// and reports the cost of an update against re-generating and re-parsing the source.
+
+template <typename F>
+auto measure(F&& fn) -> double {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+constexpr auto frames = 300;
+
+int main() {
+    auto layout = layout::LayoutContext({ .x = 0, .y = 0, .width = 50, .height = 12 });
+    auto terminal = core::Terminal(50, 12);
+    auto device = core::Device(&terminal);
+
+    auto context = xml::static_document<R"(
+        <col border="thin solid blue" padding="0c 1c">
+            <row><text>Frame: </text><b>{{frame}}</b></row>
+            <row><text>Disk usage: </text><b color="{{level}}">{{usage}}%</b></row>
+            <text>Status: {{status}}</text>
+        </col>
+    )">.instantiate();
+    auto bindings = xml::Bindings(context.get());
+    auto frame = bindings.index_of("frame");
+    auto usage = bindings.index_of("usage");
+    auto level = bindings.index_of("level");
+    auto status = bindings.index_of("status");
+
+    auto text = std::string{};
+    auto bound = measure([&] {
+        for (auto i = 0; i < frames; ++i) {
+            text = std::to_string(i);
+            bindings.set(frame, text);
+            text = std::to_string(i % 100);
+            bindings.set(usage, text);
+            bindings.set(level, i % 100 > 90 ? "red" : "green");
+            bindings.set(status, i % 100 > 90 ? "almost full" : "ok");
+            layout.compute(context.get());
+            layout.render(device, context.get());
+        }
+    });
+
+    auto reparsed = measure([&] {
+        for (auto i = 0; i < frames; ++i) {
+            auto source = std::format(R"(
+                <col border="thin solid blue" padding="0c 1c">
+                    <row><text>Frame: </text><b>{}</b></row>
+                    <row><text>Disk usage: </text><b color="{}">{}%</b></row>
+                    <text>Status: {}</text>
+                </col>
+            )", i, i % 100 > 90 ? "red" : "green", i % 100, i % 100 > 90 ? "almost full" : "ok");
+            auto l = xml::Lexer(source, "frame");
+            l.lex();
+            auto parser = xml::Parser(std::move(l));
+            parser.parse();
+            auto fresh = layout::LayoutContext({ .x = 0, .y = 0, .width = 50, .height = 12 });
+            fresh.compute(parser.context.get());
+            fresh.render(device, parser.context.get());
+        }
+    });
+
+    std::println("per frame | bindings: {:.1f} us | re-parse: {:.1f} us", bound / frames, reparsed / frames);
+    return 0;
+}
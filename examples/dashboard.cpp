@@ -0,0 +1,69 @@
+#include <print>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "termml.hpp"
+
+using namespace termml;
+
+// Lays out a dashboard of large panes on one thread and on every hardware thread. Panes
+// are blocks, so each one is laid out on its own and moved into place afterwards.
+
+template <typename F>
+auto measure(F&& fn) -> double {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+constexpr auto panes = 8;
+constexpr auto rows = 2'000;
+constexpr auto width = 120;
+constexpr auto height = 40;
+
+auto make_source() -> std::string {
+    auto source = std::string("<col>");
+    for (auto p = 0; p < panes; ++p) {
+        source += R"xml(<div border="thin solid" padding="1c">)xml";
+        for (auto i = 0; i < rows; ++i) {
+            source += "<p>";
+            source += std::to_string(i);
+            source += i % 5 == 0
+                ? " <b>warn</b> a message long enough to wrap onto a second line of the pane"
+                : " ok";
+            source += "</p>";
+        }
+        source += "</div>";
+    }
+    source += "</col>";
+    return source;
+}
+
+auto run(xml::Context* context, std::size_t threads) -> double {
+    auto best = 0.;
+    for (auto i = 0; i < 5; ++i) {
+        auto layout = layout::LayoutContext({ .x = 0, .y = 0, .width = width, .height = height });
+        layout.parallel.threads = threads;
+        auto t = measure([&] { layout.compute(context); });
+        best = i == 0 ? t : std::min(best, t);
+    }
+    return best;
+}
+
+int main() {
+    auto source = make_source();
+    auto l = xml::Lexer(source, "dashboard");
+    l.lex();
+    auto parser = xml::Parser(std::move(l));
+    parser.parse();
+    auto context = std::move(parser.context);
+
+    auto sequential = run(context.get(), 1);
+    auto parallel = run(context.get(), 0);
+    std::println(
+        "{} panes of {} rows | 1 thread: {:.2f} ms | {} threads: {:.2f} ms",
+        panes, rows, sequential, std::max(1u, std::thread::hardware_concurrency()), parallel
+    );
+    return 0;
+}
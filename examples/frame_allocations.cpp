@@ -0,0 +1,102 @@
+#include <print>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include "termml.hpp"
+
+using namespace termml;
+
+// Counts heap allocations while a dashboard is laid out and drawn frame after frame.
+// Once the buffers have grown to fit, a frame allocates nothing, whether the document is
+// unchanged or a text, a class, the scroll offset or the viewport changed. Exits with 1
+// otherwise.
+
+static std::size_t allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (auto p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+constexpr auto width = 80;
+constexpr auto height = 40;
+constexpr auto warmup = 2'000;
+constexpr auto frames = 100;
+
+auto make_source() -> std::string {
+    auto source = std::string(R"xml(
+        <style>.ok { color: green; } .warn { color: yellow; }</style>
+        <col border="thin solid" padding="1c">
+            <row><b>Status</b> <text id="status" class="ok">starting</text></row>
+    )xml");
+    for (auto i = 0; i < 40; ++i) {
+        source += i % 4 == 0 ? R"xml(<p class="warn">)xml" : R"xml(<p class="ok">)xml";
+        source += std::to_string(i);
+        source += " <b>job</b> with a description long enough to wrap onto a second line</p>";
+    }
+    source += R"xml(<col id="log" virtual-rows="auto" height="10c">)xml";
+    for (auto i = 0; i < 1'000; ++i) {
+        source += "<p>entry ";
+        source += std::to_string(i);
+        source += "</p>";
+    }
+    source += "</col></col>";
+    return source;
+}
+
+int main() {
+    auto source = make_source();
+    auto l = xml::Lexer(source, "frame_allocations");
+    l.lex();
+    auto parser = xml::Parser(std::move(l));
+    parser.parse();
+    auto context = std::move(parser.context);
+
+    auto layout = layout::LayoutContext({ .x = 0, .y = 0, .width = width, .height = height });
+    auto terminal = core::Terminal(width, height);
+    auto device = core::Device(&terminal);
+
+    auto const status = context->query("#status");
+    auto const status_text = context->element_nodes[status].childern[0].index;
+    auto const log = context->query("#log");
+    // The texts are viewed, not copied; one is rewritten while the other is shown.
+    auto buffers = std::array<std::array<char, 32>, 2>{};
+
+    auto change = [&](std::string_view scenario, int frame) {
+        if (scenario == "text") {
+            auto& buffer = buffers[static_cast<std::size_t>(frame % 2)];
+            auto size = std::snprintf(buffer.data(), buffer.size(), "%d jobs done", frame);
+            context->set_text_view(status_text, std::string_view(buffer.data(), static_cast<std::size_t>(size)));
+        } else if (scenario == "class") {
+            context->set_attribute_view(status, "class", frame % 2 ? "warn" : "ok");
+        } else if (scenario == "scroll") {
+            layout.scroll_by(log, frame % 20 < 10 ? 3 : -3);
+        } else if (scenario == "resize") {
+            layout.viewport.width = frame % 2 ? width - 10 : width;
+        }
+    };
+
+    auto failed = false;
+    for (auto scenario: { "unchanged", "text", "class", "scroll", "resize" }) {
+        auto frame = [&](int i) {
+            change(scenario, i);
+            layout.compute(context.get());
+            layout.render(device, context.get());
+        };
+        // Texts that change every frame fill the line cache before it reuses entries.
+        for (auto i = 0; i < warmup; ++i) frame(i);
+        allocations = 0;
+        for (auto i = warmup; i < warmup + frames; ++i) frame(i);
+        auto const count = allocations;
+        std::println("{:>9}: {} allocations in {} frames", scenario, count, frames);
+        failed |= count != 0;
+    }
+    return failed ? 1 : 0;
+}
@@ -13,7 +13,8 @@ void sleep_frame(std::chrono::steady_clock::time_point start, int ms = 16) {
 }
 
 int main() {
-    std::string_view source = R"(
+    // Parsed and styled at compile time; a malformed template fails to build.
+    auto context = xml::static_document<R"(
     <row color="red" border="thin solid red" border-type="rounded">
         <b min-width="30%">
             ⚠️ Warnin Lorem Ipsum is simply dummy\n text of the printing and typesetting industry. Lorem Ipsum has been the industry's standard dummy text ever since the 1500s, when an unknown printer took a galley of type and scrambled it to make a type specimen book. It has survived not only five centuries, but also the leap into electronic typesetting, remaining essentially unchanged. It was popularised in the 1960s with the release of Letraset sheets containing Lorem Ipsum passages, and more recently with desktop publishing software like Aldus PageMaker including versions of Lorem Ipsum.g:
@@ -25,21 +26,17 @@ int main() {
         <text>Usage:</text>
         <b color="#ff5555">95%</b>
     </col>
-)";
-    auto l = xml::Lexer(source, "unknown");
-    l.lex();
-    auto parser = xml::Parser(std::move(l));
-    parser.parse();
+)">.instantiate();
     auto layout = layout::LayoutContext({ .x = 0, .y = 0, .width = 50, .height = 50 });
-    layout.compute(parser.context.get());
-    // parser.context->dump_xml();
-    // layout.dump(parser.context.get());
+    layout.compute(context.get());
+    // context->dump_xml();
+    // layout.dump(context.get());
 
     auto terminal = core::Terminal(50, 50);
     auto device = core::Device(&terminal);
     auto& cmd = core::Command::out();
 
-    layout.render(device, parser.context.get());
+    layout.render(device, context.get());
     device.flush(cmd, 0, 0);
 
     
@@ -48,7 +45,7 @@ int main() {
     //     .container = { .width = 20, .height = 100 },
     // };
     //
-    // auto style = parser.context->styles[0];
+    // auto style = context->styles[0];
     // t.container.height = t.measure_height(style);
     //
     // // style.whitespace = style::Whitespace::PreLine;
@@ -0,0 +1,63 @@
+#include <print>
+#include <chrono>
+#include <string>
+#include "termml.hpp"
+
+using namespace termml;
+
+// <col><col>...x...</col></col>
+auto make_deep(std::size_t depth) -> std::string {
+    auto res = std::string{};
+    res.reserve(depth * 12 + 1);
+    for (auto i = 0ul; i < depth; ++i) res += "<col>";
+    res += "x";
+    for (auto i = 0ul; i < depth; ++i) res += "</col>";
+    return res;
+}
+
+// <col><text>x</text>...</col>
+auto make_wide(std::size_t width) -> std::string {
+    auto res = std::string{};
+    res.reserve(width * 14 + 11);
+    res += "<col>";
+    for (auto i = 0ul; i < width; ++i) res += "<text>x</text>";
+    res += "</col>";
+    return res;
+}
+
+template <typename F>
+auto measure(F&& fn) -> double {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+auto run(std::string_view name, std::string const& source) -> void {
+    auto l = xml::Lexer(source, name);
+    auto lex = measure([&] { l.lex(); });
+
+    auto parser = xml::Parser(std::move(l));
+    auto parse = measure([&] { parser.parse(); });
+
+    auto& context = *parser.context;
+    auto css = measure([&] { context.resolve_css(); });
+
+    auto nodes = static_cast<double>(context.element_nodes.size() + context.text_nodes.size());
+    std::println(
+        "{:<12} nodes: {:>8} | lex: {:>7.1f} ns/node | parse: {:>7.1f} ns/node | css: {:>7.1f} ns/node",
+        name, context.element_nodes.size() + context.text_nodes.size(),
+        lex / nodes, parse / nodes, css / nodes
+    );
+}
+
+int main() {
+    for (auto depth: { 1'000ul, 10'000ul, 100'000ul }) {
+        run(std::format("deep-{}", depth), make_deep(depth));
+    }
+
+    for (auto width: { 10'000ul, 100'000ul, 1'000'000ul }) {
+        run(std::format("wide-{}", width), make_wide(width));
+    }
+    return 0;
+}
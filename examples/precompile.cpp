@@ -0,0 +1,47 @@
+#include <print>
+#include <chrono>
+#include <string>
+#include "termml.hpp"
+
+using namespace termml;
+
+// Usage: precompile <input.xml> <output.tmlb>
+// Compiles a document into the binary format and compares the time it takes to get
+// a style-resolved context from source against loading the binary.
+
+template <typename F>
+auto measure(F&& fn) -> double {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::println("usage: {} <input.xml> <output.tmlb>", argv[0]);
+        return 1;
+    }
+
+    auto from_source = std::unique_ptr<xml::Context>{};
+    auto parse = measure([&] {
+        auto l = xml::Lexer(argv[1]);
+        l.lex();
+        auto parser = xml::Parser(std::move(l));
+        parser.parse();
+        parser.context->resolve_css();
+        from_source = std::move(parser.context);
+    });
+
+    xml::binary::save(*from_source, argv[2]);
+
+    auto loaded = std::unique_ptr<xml::Context>{};
+    auto load = measure([&] { loaded = xml::binary::load(argv[2]); });
+
+    std::println(
+        "nodes: {} | source: {:.1f} us | binary: {:.1f} us",
+        loaded->element_nodes.size() + loaded->text_nodes.size(),
+        parse, load
+    );
+    return 0;
+}
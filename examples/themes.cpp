@@ -0,0 +1,69 @@
+#include <print>
+#include <chrono>
+#include "termml.hpp"
+
+using namespace termml;
+
+// Switches a screen between a dark and a light theme, once by swapping the palette its
+// colors refer to and once by rewriting every color attribute.
+
+template <typename F>
+auto measure(F&& fn) -> double {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+constexpr auto frames = 300;
+
+constexpr auto source = R"xml(
+    <col border="thin solid palette(border)" color="palette(foreground)" background-color="palette(background)">
+        <row><text color="palette(primary)">Build: </text><b color="palette(success)">passing</b></row>
+        <row><text color="palette(primary)">Disk usage: </text><b color="palette(warning)">91%</b></row>
+        <text color="palette(muted)">Press t to switch themes</text>
+    </col>
+)xml";
+
+auto make_palette(bool dark) -> css::Palette {
+    auto palette = css::Palette{};
+    palette.set(css::PaletteSlot::Foreground, dark ? css::Color(220, 220, 220) : css::Color(30, 30, 30));
+    palette.set(css::PaletteSlot::Background, dark ? css::Color(24, 24, 28) : css::Color(250, 250, 245));
+    palette.set(css::PaletteSlot::Border, dark ? css::Color::BrightBlack : css::Color::Black);
+    palette.set(css::PaletteSlot::Primary, dark ? css::Color::BrightBlue : css::Color::Blue);
+    return palette;
+}
+
+int main() {
+    auto l = xml::Lexer(source, "themes");
+    l.lex();
+    auto parser = xml::Parser(std::move(l));
+    parser.parse();
+    auto context = std::move(parser.context);
+
+    auto layout = layout::LayoutContext({ .x = 0, .y = 0, .width = 50, .height = 8 });
+    auto terminal = core::Terminal(50, 8);
+    auto device = core::Device(&terminal);
+    auto themes = std::array{ make_palette(true), make_palette(false) };
+
+    auto swapped = measure([&] {
+        for (auto i = 0; i < frames; ++i) {
+            layout.set_palette(themes[i % 2]);
+            layout.compute(context.get());
+            layout.render(device, context.get());
+        }
+    });
+
+    // The same switch done by rewriting the attributes restyles and lays out again.
+    auto colored = context->query_all("[color]");
+    auto rewritten = measure([&] {
+        for (auto i = 0; i < frames; ++i) {
+            for (auto n: colored) context->set_attribute(n, "color", i % 2 ? "black" : "white");
+            layout.compute(context.get());
+            layout.render(device, context.get());
+        }
+    });
+
+    std::println("per switch | palette: {:.1f} us | attributes: {:.1f} us", swapped / frames, rewritten / frames);
+    return 0;
+}
@@ -0,0 +1,70 @@
+#include <print>
+#include <chrono>
+#include <string>
+#include "termml.hpp"
+
+using namespace termml;
+
+// Scrolls through a list of 100k rows. With `virtual-rows` only the rows in view are
+// laid out and drawn, so a frame costs the same at any length.
+
+template <typename F>
+auto measure(F&& fn) -> double {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count();
+}
+
+constexpr auto rows = 100'000;
+constexpr auto frames = 300;
+constexpr auto width = 80;
+constexpr auto height = 24;
+
+auto make_source() -> std::string {
+    auto source = std::string(R"xml(<col id="log" virtual-rows="auto" height="24c">)xml");
+    for (auto i = 0; i < rows; ++i) {
+        source += "<p>";
+        source += std::to_string(i);
+        source += i % 7 == 0
+            ? " a request that took long enough to be logged with the whole of its path"
+            : " ok";
+        source += "</p>";
+    }
+    source += "</col>";
+    return source;
+}
+
+int main() {
+    auto source = make_source();
+    auto l = xml::Lexer(source, "virtual_list");
+    l.lex();
+    auto parser = xml::Parser(std::move(l));
+    parser.parse();
+    auto context = std::move(parser.context);
+
+    auto layout = layout::LayoutContext({ .x = 0, .y = 0, .width = width, .height = height });
+    auto terminal = core::Terminal(width, height);
+    auto device = core::Device(&terminal);
+    auto log = context->query("#log");
+
+    auto first = measure([&] {
+        layout.compute(context.get());
+        layout.render(device, context.get());
+    });
+
+    // Page down from the top; every frame scrolls by a screen.
+    auto scrolled = measure([&] {
+        for (auto i = 0; i < frames; ++i) {
+            layout.scroll_by(log, height);
+            layout.compute(context.get());
+            layout.render(device, context.get());
+        }
+    });
+
+    std::println(
+        "{} rows | first frame: {:.1f} us | per scroll: {:.1f} us | rows laid out: {}",
+        rows, first, scrolled / frames, layout.visible_rows(log).size()
+    );
+    return 0;
+}
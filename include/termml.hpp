@@ -3,5 +3,10 @@
 #include "termml/xml/lexer.hpp"
 #include "termml/xml/node.hpp"
 #include "termml/xml/parser.hpp"
+#include "termml/xml/binary.hpp"
+#include "termml/xml/static_document.hpp"
+#include "termml/xml/bindings.hpp"
+#include "termml/xml/parallel_parser.hpp"
 #include "termml/css/style.hpp"
+#include "termml/css/stylesheet.hpp"
 #include "termml/layout/layout.hpp"
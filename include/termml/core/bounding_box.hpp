@@ -12,6 +12,8 @@ namespace termml::core {
         int width{};
         int height{};
 
+        constexpr auto operator==(BoundingBox const&) const noexcept -> bool = default;
+
         constexpr auto min_x() const noexcept -> int { return x; }
         constexpr auto min_y() const noexcept -> int { return y; }
         constexpr auto max_x() const noexcept -> int { return x + width; }
@@ -24,6 +26,18 @@ namespace termml::core {
                      min_y() >= other.max_y());   // this box is completely below
         }
 
+        // The part of both boxes; empty when they do not intersect.
+        constexpr auto intersection(BoundingBox const& other) const noexcept -> BoundingBox {
+            auto const x_ = std::max(min_x(), other.min_x());
+            auto const y_ = std::max(min_y(), other.min_y());
+            return {
+                .x = x_,
+                .y = y_,
+                .width = std::max(std::min(max_x(), other.max_x()) - x_, 0),
+                .height = std::max(std::min(max_y(), other.max_y()) - y_, 0)
+            };
+        }
+
         static constexpr auto inf() noexcept -> BoundingBox {
             return {
                 .x = 0,
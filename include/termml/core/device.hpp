@@ -5,7 +5,7 @@
 #include "point.hpp"
 #include "commands.hpp"
 #include "bounding_box.hpp"
-#include "utf8.hpp"
+#include "unicode.hpp"
 #include <cassert>
 #include <cstdint>
 #include <format>
@@ -37,6 +37,20 @@ namespace termml::core {
             };
         }
 
+        // Palette references are resolved here, so the pixel only holds concrete colors.
+        static constexpr auto from_style(css::PaintStyle const& style, css::Palette const& palette) noexcept -> PixelStyle {
+            return {
+                .fg_color = palette.resolve(style.fg_color),
+                .bg_color = palette.resolve(style.bg_color),
+                .bold = style.text_style.bold,
+                .dim = style.text_style.dim,
+                .italic = style.text_style.italic,
+                .underline = style.text_style.underline,
+                .strike = style.text_style.strike,
+                .z_index = style.z_index
+            };
+        }
+
         constexpr auto operator==(PixelStyle const&) const noexcept -> bool = default;
 
         constexpr auto is_same_style(PixelStyle const& other) const noexcept -> bool {
@@ -148,6 +162,8 @@ namespace termml::core {
             return m_screen->cols();
         }
 
+        // Writes `text` one grapheme cluster at a time, advancing by the cells each one
+        // takes up. A wide cluster whose right half would be clipped is left out.
         constexpr auto write_text(
             std::string_view text,
             int x,
@@ -156,13 +172,18 @@ namespace termml::core {
         ) noexcept -> std::pair<std::size_t /*text rendered*/, int /*pixels consumed*/> {
             auto i = std::size_t{};
             if (y >= m_viewport.max_y()) return { 0, x };
-            for (; i < text.size(); ++x) {
-                auto len = ::termml::core::utf8::get_length(text[i]);
-                assert(i + len <= text.size());
-                auto txt = text.substr(i, len);
+            while (i < text.size()) {
+                auto [end, width] = unicode::cluster_at(text, i);
+                auto txt = text.substr(i, end - i);
+                if (width == 0) {
+                    i = end;
+                    continue;
+                }
+                if (width == 2 && !m_viewport.in(x + 1, y)) txt = " ";
                 if (put_pixel(txt, x, y, p) == PutPixelResult::OutOfBound) break;
                 if (x >= m_viewport.max_x()) break;
-                i += len;
+                i = end;
+                x += width;
             }
             return { i, x };
         }
@@ -0,0 +1,146 @@
+#ifndef AMT_TERMML_CORE_MAPPED_FILE_HPP
+#define AMT_TERMML_CORE_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#    define WIN32_IS_MEAN_WAS_LOCALLY_DEFINED
+#  endif
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#    define NOMINMAX_WAS_LOCALLY_DEFINED
+#  endif
+#
+#  include <windows.h>
+#
+#  ifdef WIN32_IS_MEAN_WAS_LOCALLY_DEFINED
+#    undef WIN32_IS_MEAN_WAS_LOCALLY_DEFINED
+#    undef WIN32_LEAN_AND_MEAN
+#  endif
+#  ifdef NOMINMAX_WAS_LOCALLY_DEFINED
+#    undef NOMINMAX_WAS_LOCALLY_DEFINED
+#    undef NOMINMAX
+#  endif
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace termml::core {
+
+    // Read-only mapping of a whole file; the pages stay valid until it is destroyed.
+    struct MappedFile {
+        MappedFile(std::string_view p) {
+            auto path = std::string(p);
+#ifdef _WIN32
+            m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE) {
+                throw std::runtime_error(std::format("file not found: {}", path));
+            }
+
+            auto size = LARGE_INTEGER{};
+            if (!GetFileSizeEx(m_file, &size)) {
+                close();
+                throw std::runtime_error(std::format("unable to read file size: {}", path));
+            }
+            m_size = static_cast<std::size_t>(size.QuadPart);
+            if (m_size == 0) return;
+
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_mapping) m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+            auto fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error(std::format("file not found: {}", path));
+            }
+
+            struct stat st{};
+            if (::fstat(fd, &st) != 0) {
+                ::close(fd);
+                throw std::runtime_error(std::format("unable to read file size: {}", path));
+            }
+            m_size = static_cast<std::size_t>(st.st_size);
+            if (m_size == 0) {
+                ::close(fd);
+                return;
+            }
+
+            auto data = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            // The mapping keeps its own reference to the file.
+            ::close(fd);
+            if (data != MAP_FAILED) m_data = data;
+#endif
+            if (!m_data) {
+                close();
+                throw std::runtime_error(std::format("unable to map file: {}", path));
+            }
+        }
+
+        MappedFile(MappedFile const&) = delete;
+        MappedFile& operator=(MappedFile const&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept
+            : m_data(std::exchange(other.m_data, nullptr))
+            , m_size(std::exchange(other.m_size, 0))
+#ifdef _WIN32
+            , m_file(std::exchange(other.m_file, INVALID_HANDLE_VALUE))
+            , m_mapping(std::exchange(other.m_mapping, nullptr))
+#endif
+        {}
+
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if (this == &other) return *this;
+            close();
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+            m_file = std::exchange(other.m_file, INVALID_HANDLE_VALUE);
+            m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+            return *this;
+        }
+
+        ~MappedFile() {
+            close();
+        }
+
+        constexpr auto data() const noexcept -> std::byte const* { return static_cast<std::byte const*>(m_data); }
+        constexpr auto size() const noexcept -> std::size_t { return m_size; }
+        constexpr auto bytes() const noexcept -> std::span<std::byte const> { return { data(), m_data ? m_size : 0 }; }
+
+    private:
+        auto close() noexcept -> void {
+#ifdef _WIN32
+            if (m_data) UnmapViewOfFile(m_data);
+            if (m_mapping) CloseHandle(m_mapping);
+            if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+            m_mapping = nullptr;
+            m_file = INVALID_HANDLE_VALUE;
+#else
+            if (m_data) ::munmap(const_cast<void*>(m_data), m_size);
+#endif
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+    private:
+        void const* m_data{};
+        std::size_t m_size{};
+#ifdef _WIN32
+        HANDLE m_file{INVALID_HANDLE_VALUE};
+        HANDLE m_mapping{};
+#endif
+    };
+
+} // namespace termml::core
+
+#endif // AMT_TERMML_CORE_MAPPED_FILE_HPP
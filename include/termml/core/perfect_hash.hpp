@@ -0,0 +1,76 @@
+#ifndef AMT_TERMML_CORE_PERFECT_HASH_HPP
+#define AMT_TERMML_CORE_PERFECT_HASH_HPP
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+namespace termml::core {
+
+    namespace detail {
+        constexpr auto fnv1a(std::string_view key, std::uint64_t seed) noexcept -> std::uint64_t {
+            auto h = 0xcbf29ce484222325ull ^ seed;
+            for (auto c: key) {
+                h ^= static_cast<std::uint8_t>(c);
+                h *= 0x100000001b3ull;
+            }
+            return h ^ (h >> 32);
+        }
+    } // namespace detail
+
+    // Collision-free string -> value table for a fixed key set. The seed is searched
+    // at compile time, so a lookup is one hash, one mask and one string compare.
+    template <typename V, std::size_t N>
+    struct PerfectHash {
+        // Sparse enough that a collision-free seed is found within a few tries.
+        static constexpr std::size_t table_size = std::bit_ceil(N) * 4;
+
+        std::array<std::string_view, table_size> keys{};
+        std::array<V, table_size> values{};
+        std::uint64_t seed{};
+
+        consteval PerfectHash(std::array<std::pair<std::string_view, V>, N> const& entries) {
+            for (; seed < 1'000; ++seed) {
+                if (try_seed(entries)) return;
+            }
+            throw "PerfectHash: unable to find a collision-free seed";
+        }
+
+        constexpr auto slot(std::string_view key) const noexcept -> std::size_t {
+            return static_cast<std::size_t>(detail::fnv1a(key, seed)) & (table_size - 1);
+        }
+
+        constexpr auto find(std::string_view key) const noexcept -> V const* {
+            auto i = slot(key);
+            if (keys[i].empty() || keys[i] != key) return nullptr;
+            return &values[i];
+        }
+
+        constexpr auto get(std::string_view key, V def = {}) const noexcept -> V {
+            if (auto v = find(key)) return *v;
+            return def;
+        }
+
+        constexpr auto contains(std::string_view key) const noexcept -> bool {
+            return find(key) != nullptr;
+        }
+
+    private:
+        constexpr auto try_seed(std::array<std::pair<std::string_view, V>, N> const& entries) -> bool {
+            keys = {};
+            values = {};
+            for (auto const& [k, v]: entries) {
+                auto i = slot(k);
+                if (!keys[i].empty()) return false;
+                keys[i] = k;
+                values[i] = v;
+            }
+            return true;
+        }
+    };
+
+} // namespace termml::core
+
+#endif // AMT_TERMML_CORE_PERFECT_HASH_HPP
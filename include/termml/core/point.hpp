@@ -16,7 +16,7 @@ namespace termml::core {
             return { .x = x, .y = std::clamp(y, min, max) };
         }
 
-        constexpr auto operator==(Point const&) const noexcept -> bool;
+        constexpr auto operator==(Point const&) const noexcept -> bool = default;
     };
 
 } // namespace termml::core
@@ -1,7 +1,11 @@
 #ifndef AMT_TERMML_CORE_STRING_UTILS_HPP
 #define AMT_TERMML_CORE_STRING_UTILS_HPP
 
+#include <concepts>
+#include <cstdint>
+#include <limits>
 #include <string>
+#include <string_view>
 
 namespace termml::core::utils {
 
@@ -35,6 +39,209 @@ namespace termml::core::utils {
         return ltrim(rtrim(str, chars), chars);
     }
 
+    // Locale-independent replacements for <cctype>/<charconv>/<cstdlib> that also work
+    // in constant expressions, so styles can be parsed at compile time.
+
+    static constexpr auto is_space(char c) noexcept -> bool {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+
+    static constexpr auto is_digit(char c) noexcept -> bool {
+        return c >= '0' && c <= '9';
+    }
+
+    static constexpr auto digit_value(char c) noexcept -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+        return std::numeric_limits<int>::max();
+    }
+
+    // Parses the leading integer of `s` like `std::from_chars`: `out` is left untouched
+    // when there is no number or it does not fit. Returns the number of characters used.
+    template <std::integral T>
+    static constexpr auto parse_integer(std::string_view s, T& out, int base = 10) noexcept -> std::size_t {
+        auto i = std::size_t{};
+        auto negative = false;
+        if constexpr (std::is_signed_v<T>) {
+            if (!s.empty() && s[0] == '-') {
+                negative = true;
+                ++i;
+            }
+        }
+
+        auto start = i;
+        auto value = static_cast<unsigned long long>(0);
+        auto overflow = false;
+        for (; i < s.size() && digit_value(s[i]) < base; ++i) {
+            auto next = value * static_cast<unsigned long long>(base) + static_cast<unsigned long long>(digit_value(s[i]));
+            overflow |= (next / static_cast<unsigned long long>(base)) != value;
+            value = next;
+        }
+        if (i == start) return 0;
+
+        auto limit = static_cast<unsigned long long>(std::numeric_limits<T>::max()) + (negative ? 1 : 0);
+        if (overflow || value > limit) return i;
+        out = negative ? static_cast<T>(0 - value) : static_cast<T>(value);
+        return i;
+    }
+
+    // Parses the leading decimal number of `s` ("-12.5" in "-12.5%") like `std::strtof`
+    // without hex, infinity or NaN support. Returns 0 if there is no number.
+    static constexpr auto parse_float(std::string_view s) noexcept -> float {
+        auto i = std::size_t{};
+        while (i < s.size() && is_space(s[i])) ++i;
+
+        auto sign = 1.0;
+        if (i < s.size() && (s[i] == '-' || s[i] == '+')) {
+            if (s[i] == '-') sign = -1.0;
+            ++i;
+        }
+
+        auto value = 0.0;
+        auto digits = 0;
+        for (; i < s.size() && is_digit(s[i]); ++i, ++digits) {
+            value = value * 10 + (s[i] - '0');
+        }
+
+        if (i < s.size() && s[i] == '.') {
+            auto scale = 0.1;
+            for (++i; i < s.size() && is_digit(s[i]); ++i, ++digits) {
+                value += (s[i] - '0') * scale;
+                scale /= 10;
+            }
+        }
+        if (digits == 0) return 0.f;
+
+        if (i < s.size() && (s[i] == 'e' || s[i] == 'E')) {
+            auto j = i + 1;
+            auto exp_sign = 1;
+            if (j < s.size() && (s[j] == '-' || s[j] == '+')) {
+                if (s[j] == '-') exp_sign = -1;
+                ++j;
+            }
+            auto exponent = 0;
+            auto has_exponent = false;
+            for (; j < s.size() && is_digit(s[j]) && exponent < 64; ++j) {
+                exponent = exponent * 10 + (s[j] - '0');
+                has_exponent = true;
+            }
+            for (; has_exponent && exponent > 0; --exponent) {
+                value = exp_sign > 0 ? value * 10 : value / 10;
+            }
+        }
+
+        return static_cast<float>(sign * value);
+    }
+
+    namespace detail {
+        inline constexpr auto invalid_codepoint = char32_t{0x110000};
+
+        // Character a backslash escape stands for, or '\0' if `c` does not start one.
+        static constexpr auto escape_value(char c) noexcept -> char {
+            switch (c) {
+                case 'n': return '\n';
+                case 'r': return '\r';
+                case 't': return '\t';
+                case 'b': return '\b';
+                case 'f': return '\f';
+                case 'v': return '\v';
+                case '\\': return '\\';
+                case '\'': return '\'';
+                case '"': return '"';
+                default: return '\0';
+            }
+        }
+
+        // Codepoint of the reference between '&' and ';', or `invalid_codepoint`.
+        static constexpr auto reference_value(std::string_view ref) noexcept -> char32_t {
+            if (ref == "amp") return '&';
+            if (ref == "lt") return '<';
+            if (ref == "gt") return '>';
+            if (ref == "quot") return '"';
+            if (ref == "apos") return '\'';
+            if (!ref.starts_with('#')) return invalid_codepoint;
+
+            auto base = 10;
+            ref = ref.substr(1);
+            if (ref.starts_with('x') || ref.starts_with('X')) {
+                base = 16;
+                ref = ref.substr(1);
+            }
+            auto cp = std::uint32_t{invalid_codepoint};
+            if (ref.empty() || parse_integer(ref, cp, base) != ref.size()) return invalid_codepoint;
+            if (cp == 0 || (cp >= 0xD800 && cp < 0xE000) || cp >= invalid_codepoint) return invalid_codepoint;
+            return static_cast<char32_t>(cp);
+        }
+
+        template <typename Out>
+        constexpr auto put_utf8(char32_t cp, Out& out) -> void {
+            char bytes[4]{};
+            auto size = 0;
+            if (cp < 0x80) {
+                bytes[size++] = static_cast<char>(cp);
+            } else if (cp < 0x800) {
+                bytes[size++] = static_cast<char>(0xC0 | (cp >> 6));
+                bytes[size++] = static_cast<char>(0x80 | (cp & 0x3F));
+            } else if (cp < 0x10000) {
+                bytes[size++] = static_cast<char>(0xE0 | (cp >> 12));
+                bytes[size++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                bytes[size++] = static_cast<char>(0x80 | (cp & 0x3F));
+            } else {
+                bytes[size++] = static_cast<char>(0xF0 | (cp >> 18));
+                bytes[size++] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                bytes[size++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                bytes[size++] = static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            out(std::string_view(bytes, static_cast<std::size_t>(size)));
+        }
+    } // namespace detail
+
+    // Decodes the backslash escapes of an attribute value ("\n", "\t", "\"", "\\", ...)
+    // and passes the result to `out` in pieces. An unknown escape and a trailing
+    // backslash are dropped. The result is never longer than `s`. Shared by the runtime
+    // and the template parser.
+    template <typename Out>
+    static constexpr auto unescape(std::string_view s, Out&& out) -> void {
+        while (!s.empty()) {
+            auto slash = s.find('\\');
+            out(s.substr(0, slash));
+            if (slash == std::string_view::npos || slash + 1 == s.size()) return;
+            if (auto c = detail::escape_value(s[slash + 1]); c != '\0') out(std::string_view(&c, 1));
+            s = s.substr(slash + 2);
+        }
+    }
+
+    // Decodes the character references of text ("&amp;", "&lt;", "&gt;", "&quot;",
+    // "&apos;", "&#65;" and "&#x41;") and passes the result to `out` in pieces. A
+    // reference that is unterminated, unknown or not a valid codepoint is passed through
+    // as written. Returns the offset of the first such reference, or `npos`. The result
+    // is never longer than `s`.
+    template <typename Out>
+    static constexpr auto decode_references(std::string_view s, Out&& out) -> std::size_t {
+        auto invalid = std::string_view::npos;
+        auto offset = std::size_t{};
+        while (true) {
+            auto amp = s.find('&');
+            out(s.substr(0, amp));
+            if (amp == std::string_view::npos) return invalid;
+
+            auto end = s.find(';', amp);
+            auto cp = end == std::string_view::npos
+                ? detail::invalid_codepoint
+                : detail::reference_value(s.substr(amp + 1, end - amp - 1));
+            if (cp == detail::invalid_codepoint) {
+                if (invalid == std::string_view::npos) invalid = offset + amp;
+                out(s.substr(amp, 1));
+                end = amp;
+            } else {
+                detail::put_utf8(cp, out);
+            }
+            offset += end + 1;
+            s = s.substr(end + 1);
+        }
+    }
+
 } // namespace termml::core::utils
 
 #endif // AMT_TERMML_CORE_STRING_UTILS_HPP
@@ -0,0 +1,59 @@
+#ifndef AMT_TERMML_CORE_TAG_HPP
+#define AMT_TERMML_CORE_TAG_HPP
+
+#include "perfect_hash.hpp"
+#include <cstdint>
+#include <string_view>
+
+namespace termml::core {
+
+    // Tags the library attaches meaning to; everything else is `Unknown` and
+    // behaves like a generic block container.
+    enum class TagId: std::uint8_t {
+        Unknown,
+        Root, // "#root"
+        Text,
+        Span,
+        Em,
+        B,
+        Strong,
+        I,
+        Br,
+        Img,
+        Row,
+        Col,
+        Style
+    };
+
+    namespace detail {
+        static constexpr auto tag_table = PerfectHash<TagId, 12>({{
+            { "#root",  TagId::Root },
+            { "text",   TagId::Text },
+            { "span",   TagId::Span },
+            { "em",     TagId::Em },
+            { "b",      TagId::B },
+            { "strong", TagId::Strong },
+            { "i",      TagId::I },
+            { "br",     TagId::Br },
+            { "img",    TagId::Img },
+            { "row",    TagId::Row },
+            { "col",    TagId::Col },
+            { "style",  TagId::Style },
+        }});
+    } // namespace detail
+
+    constexpr auto intern_tag(std::string_view tag) noexcept -> TagId {
+        return detail::tag_table.get(tag, TagId::Unknown);
+    }
+
+    // Void elements never keep their children.
+    constexpr auto is_void_tag(TagId tag) noexcept -> bool {
+        return tag == TagId::Br || tag == TagId::Img;
+    }
+
+    static_assert(intern_tag("col") == TagId::Col);
+    static_assert(intern_tag("div") == TagId::Unknown);
+
+} // namespace termml::core
+
+#endif // AMT_TERMML_CORE_TAG_HPP
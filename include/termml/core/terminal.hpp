@@ -4,41 +4,52 @@
 #include "device.hpp"
 #include "commands.hpp"
 #include "bounding_box.hpp"
+#include "unicode.hpp"
 #include "utf8.hpp"
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 namespace termml::core {
 
     struct Terminal {
         struct Cell {
+            // Longest grapheme cluster a cell holds; longer ones keep their leading
+            // codepoints.
+            static constexpr std::size_t capacity = 15;
+
             PixelStyle style{};
 
-            char buff[4]{};
+            char buff[capacity]{};
             std::uint8_t len{};
+            // 2 for the left cell of a wide glyph and 0 for the cell to its right, which
+            // the glyph covers and which holds no text.
+            std::uint8_t width{1};
 
             bool is_dirty{true};
 
             constexpr auto set_text(std::string_view text) noexcept -> void {
+                if (text.size() > capacity) {
+                    auto size = capacity;
+                    while (size > 0 && utf8::is_continuation(text[size])) --size;
+                    text = text.substr(0, size);
+                }
                 if (this->text() == text) return;
                 is_dirty = true;
 
-                if (text.empty()) {
-                    len = 0;
-                    return;
-                }
-
-                auto size = utf8::get_length(text[0]);
-                assert(size <= text.size());
-                std::copy_n(text.begin(), size, buff);
-                len = size;
+                std::copy_n(text.begin(), text.size(), buff);
+                len = static_cast<std::uint8_t>(text.size());
             }
 
             constexpr auto text() const noexcept -> std::string_view {
                 return { buff, len };
             }
+
+            constexpr auto is_wide() const noexcept -> bool { return width == 2; }
+            constexpr auto is_continuation() const noexcept -> bool { return width == 0; }
         };
 
         Terminal() noexcept = default;
@@ -67,6 +78,8 @@ namespace termml::core {
             return m_data[r * m_cols + c];
         }
 
+        // Writes one grapheme cluster. A wide one also covers the cell to its right, or
+        // becomes a blank if that cell is off screen or above it.
         constexpr auto put_pixel(
             std::string_view pixel,
             int x, int y,
@@ -74,12 +87,19 @@ namespace termml::core {
         ) -> bool {
             if (y >= rows() || y < 0) return false;
             if (x >= cols() || x < 0) return false;
-            auto& cell = this->operator()(static_cast<unsigned>(y), static_cast<unsigned>(x));
-            if (cell.style.z_index > style.z_index) return true;
-            if (!cell.style.is_same_style(style)) cell.is_dirty = true;
-            cell.style = style;
-            cell.set_text(pixel);
-            m_is_dirty |= cell.is_dirty;
+            auto const r = static_cast<unsigned>(y);
+            auto const c = static_cast<unsigned>(x);
+            if (this->operator()(r, c).style.z_index > style.z_index) return true;
+
+            auto wide = unicode::cluster_width(pixel) == 2;
+            if (wide && (c + 1 >= m_cols || this->operator()(r, c + 1).style.z_index > style.z_index)) {
+                pixel = {};
+                wide = false;
+            }
+
+            set_cell(r, c, pixel, style, wide ? 2 : 1);
+            if (wide) set_cell(r, c + 1, {}, style, 0);
+            repair_wide_cells(r, c, c + (wide ? 2 : 1));
             return true;
         }
 
@@ -92,16 +112,18 @@ namespace termml::core {
 
             cmd.move(1, 1);
             auto previous_style = PixelStyle{};
-            auto previous_pos = std::make_pair(0u, 0u);
+            // Where the cursor is after the last write; nothing is written yet.
+            auto cursor = std::make_pair(m_rows, 0u);
             for (auto r = 0u; r < m_rows; ++r) {
                 for (auto c = 0u; c < m_cols; ++c) {
                     auto& cell = this->operator()(r, c);
                     if (!cell.is_dirty) continue;
-                    auto [pr, pc] = previous_pos;
-                    if (!((pr == r) && (pc + 1 == c))) {
+                    cell.is_dirty = false;
+                    // Drawn with the wide glyph to its left.
+                    if (cell.is_continuation()) continue;
+
+                    if (cursor != std::make_pair(r, c)) {
                         cmd.move(c + dx + 1, r + dy + 1);
-                    } else if (cell.text().empty()) {
-                        cmd.write(" ");
                     }
 
                     if (!previous_style.is_same_style(cell.style)) {
@@ -109,10 +131,9 @@ namespace termml::core {
                         write_style(cmd, cell.style);
                     }
 
-                    cmd.write(cell.text());
+                    cmd.write(cell.text().empty() ? std::string_view(" ") : cell.text());
                     previous_style = cell.style;
-                    cell.is_dirty = false;
-                    previous_pos = { r, c };
+                    cursor = { r, c + cell.width };
                 }
             }
 
@@ -128,9 +149,35 @@ namespace termml::core {
                 for (auto c = sc; c < mc; ++c) {
                     t(r + dy, c + dx) = this->operator()(r, c);
                 }
+                if (sc < mc) t.repair_wide_cells(r + dy, sc + dx, mc + dx);
             }
         }
     private:
+        constexpr auto set_cell(unsigned r, unsigned c, std::string_view text, PixelStyle const& style, std::uint8_t width) noexcept -> void {
+            auto& cell = this->operator()(r, c);
+            if (!cell.style.is_same_style(style) || cell.width != width) cell.is_dirty = true;
+            cell.style = style;
+            cell.width = width;
+            cell.set_text(text);
+            m_is_dirty |= cell.is_dirty;
+        }
+
+        constexpr auto blank(unsigned r, unsigned c) noexcept -> void {
+            set_cell(r, c, {}, this->operator()(r, c).style, 1);
+        }
+
+        // Cells [begin, end) of row `r` were overwritten. Blanks every half of a wide
+        // glyph that lost its other half, inside the range and next to it.
+        constexpr auto repair_wide_cells(unsigned r, unsigned begin, unsigned end) noexcept -> void {
+            auto is_wide = [&](unsigned c) { return c < m_cols && this->operator()(r, c).is_wide(); };
+            auto is_continuation = [&](unsigned c) { return c < m_cols && this->operator()(r, c).is_continuation(); };
+
+            if (is_continuation(begin) && (begin == 0 || !is_wide(begin - 1))) blank(r, begin);
+            if (is_wide(end - 1) && !is_continuation(end)) blank(r, end - 1);
+            if (begin > 0 && is_wide(begin - 1) && !is_continuation(begin)) blank(r, begin - 1);
+            if (is_continuation(end) && !is_wide(end - 1)) blank(r, end);
+        }
+
         static auto write_style(Command& cmd, PixelStyle const& style) -> void {
             { // text color
                 if (style.fg_color.is_rgb()) {
@@ -0,0 +1,119 @@
+#ifndef AMT_TERMML_CORE_THREAD_POOL_HPP
+#define AMT_TERMML_CORE_THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace termml::core {
+
+    // Threads started on first use and kept until the pool is destroyed, so work split
+    // across them pays for starting them once rather than on every call.
+    struct ThreadPool {
+        ThreadPool() = default;
+        ThreadPool(ThreadPool const&) = delete;
+        ThreadPool& operator=(ThreadPool const&) = delete;
+
+        ~ThreadPool() {
+            {
+                auto lock = std::lock_guard(m_mutex);
+                m_stop = true;
+            }
+            m_wake.notify_all();
+            m_threads.clear();
+        }
+
+        // Threads started so far, not counting the callers'.
+        auto size() const noexcept -> std::size_t { return m_threads.size(); }
+
+        // Calls `fn(worker)` once for every worker below `workers`, the caller's thread as
+        // worker 0, and waits for all of them. Rethrows the first exception. Calls from
+        // several threads take turns; `fn` must not call back into the same pool.
+        template <typename Fn>
+        auto run(std::size_t workers, Fn&& fn) -> void {
+            if (workers < 2) {
+                fn(std::size_t{});
+                return;
+            }
+
+            auto turn = std::lock_guard(m_run_mutex);
+            while (m_threads.size() + 1 < workers) {
+                m_threads.emplace_back([this, worker = m_threads.size() + 1] { work(worker); });
+            }
+
+            using fn_t = std::remove_reference_t<Fn>;
+            {
+                auto lock = std::lock_guard(m_mutex);
+                m_call = [](void* f, std::size_t worker) { (*static_cast<fn_t*>(f))(worker); };
+                m_fn = const_cast<void*>(static_cast<void const*>(std::addressof(fn)));
+                m_workers = workers;
+                m_pending = workers - 1;
+                ++m_generation;
+            }
+            m_wake.notify_all();
+
+            auto error = std::exception_ptr{};
+            try {
+                fn(std::size_t{});
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            auto lock = std::unique_lock(m_mutex);
+            m_done.wait(lock, [this] { return m_pending == 0; });
+            if (!error) error = m_error;
+            m_error = nullptr;
+            lock.unlock();
+            if (error) std::rethrow_exception(error);
+        }
+
+    private:
+        auto work(std::size_t worker) -> void {
+            auto seen = std::uint64_t{};
+            auto lock = std::unique_lock(m_mutex);
+            while (true) {
+                m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+                if (m_stop) return;
+                seen = m_generation;
+                // Threads started for a larger run sit this one out.
+                if (worker >= m_workers) continue;
+
+                auto const call = m_call;
+                auto const fn = m_fn;
+                lock.unlock();
+                auto error = std::exception_ptr{};
+                try {
+                    call(fn, worker);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                lock.lock();
+                if (error && !m_error) m_error = std::move(error);
+                if (--m_pending == 0) m_done.notify_one();
+            }
+        }
+
+    private:
+        std::mutex m_run_mutex;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        void (*m_call)(void*, std::size_t){};
+        void* m_fn{};
+        std::size_t m_workers{};
+        std::size_t m_pending{};
+        std::uint64_t m_generation{};
+        std::exception_ptr m_error{};
+        bool m_stop{false};
+        std::vector<std::jthread> m_threads;
+    };
+
+} // namespace termml::core
+
+#endif // AMT_TERMML_CORE_THREAD_POOL_HPP
@@ -0,0 +1,98 @@
+#ifndef AMT_TERMML_CORE_UNICODE_HPP
+#define AMT_TERMML_CORE_UNICODE_HPP
+
+#include "char_width_table.hpp"
+#include "utf8.hpp"
+#include <cstdint>
+#include <string_view>
+
+namespace termml::core::unicode {
+
+    // Cells a codepoint takes up on its own: 0, 1 or 2. ASCII, controls included, takes
+    // one; whitespace is the layouter's business.
+    constexpr auto width(char32_t cp) noexcept -> int {
+        if (cp < 0x80) return 1;
+        if (cp > 0x10ffff) return 1;
+        auto const block = detail::width_stage1[cp >> detail::width_block_bits];
+        auto const offset = cp & ((1u << detail::width_block_bits) - 1);
+        auto const byte = detail::width_blocks[(block << (detail::width_block_bits - 2)) + (offset >> 2)];
+        return (byte >> ((offset & 3) * 2)) & 3;
+    }
+
+    constexpr auto is_regional_indicator(char32_t cp) noexcept -> bool {
+        return cp >= 0x1f1e6 && cp <= 0x1f1ff;
+    }
+
+    constexpr auto is_emoji_modifier(char32_t cp) noexcept -> bool {
+        return cp >= 0x1f3fb && cp <= 0x1f3ff;
+    }
+
+    inline constexpr char32_t zero_width_joiner = 0x200d;
+    inline constexpr char32_t emoji_presentation = 0xfe0f;
+
+    struct Cluster {
+        std::size_t end{};
+        // Cells the cluster takes up.
+        int width{};
+    };
+
+    // The grapheme cluster starting at `i`. Approximates extended grapheme clusters: a
+    // codepoint takes the marks and other zero-width codepoints after it, emoji
+    // modifiers, whatever follows a zero-width joiner, and a regional indicator takes the
+    // next one to form a flag. Whitespace and controls never join. The cluster is as wide
+    // as its first codepoint, or 2 for a flag or a cluster asking for emoji presentation.
+    constexpr auto cluster_at(std::string_view str, std::size_t i) noexcept -> Cluster {
+        auto const first = utf8::decode(str, i);
+        auto end = i + first.length;
+        // ASCII is only ever followed by marks, which are not ASCII.
+        if (end >= str.size() || static_cast<std::uint8_t>(str[end]) < 0x80) {
+            return { end, width(first.codepoint) };
+        }
+
+        auto w = width(first.codepoint);
+        auto previous = first.codepoint;
+        auto flag = is_regional_indicator(previous);
+        while (end < str.size()) {
+            auto const next = utf8::decode(str, end);
+            auto const next_width = width(next.codepoint);
+            auto const pair = flag && is_regional_indicator(next.codepoint);
+            auto const joins = next.codepoint > 0x20 && (
+                next_width == 0 ||
+                is_emoji_modifier(next.codepoint) ||
+                previous == zero_width_joiner ||
+                pair
+            );
+            if (!joins) break;
+            if (pair || (next.codepoint == emoji_presentation && w != 0)) w = 2;
+            flag = false;
+            previous = next.codepoint;
+            end += next.length;
+        }
+        return { end, w };
+    }
+
+    constexpr auto next_cluster(std::string_view str, std::size_t i) noexcept -> std::size_t {
+        return cluster_at(str, i).end;
+    }
+
+    // Cells a grapheme cluster takes up.
+    constexpr auto cluster_width(std::string_view cluster) noexcept -> int {
+        if (cluster.empty()) return 0;
+        if (cluster.size() == 1) return 1;
+        return cluster_at(cluster, 0).width;
+    }
+
+    // Cells `str` takes up when written out cluster by cluster.
+    constexpr auto display_width(std::string_view str) noexcept -> std::size_t {
+        auto res = std::size_t{};
+        for (auto i = std::size_t{}; i < str.size();) {
+            auto const cluster = cluster_at(str, i);
+            res += static_cast<std::size_t>(cluster.width);
+            i = cluster.end;
+        }
+        return res;
+    }
+
+} // namespace termml::core::unicode
+
+#endif // AMT_TERMML_CORE_UNICODE_HPP
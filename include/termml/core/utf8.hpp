@@ -2,6 +2,9 @@
 #define AMT_TERMML_CORE_UTF8_HPP
 
 #include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <string_view>
 
 namespace termml::core::utf8 {
@@ -15,15 +18,133 @@ namespace termml::core::utf8 {
         return lookup[byte >> 4];
     }
 
-    constexpr auto calculate_size(std::string_view str) -> std::size_t {
-        auto size = std::size_t{};
-        for (auto i = 0ul; i < str.size(); ) {
-            auto len = get_length(str[i]);
-            i += len;
-            ++size;
+    constexpr auto is_continuation(char c) noexcept -> bool {
+        return (static_cast<std::uint8_t>(c) & 0xc0) == 0x80;
+    }
+
+    struct Decoded {
+        char32_t codepoint{};
+        std::uint8_t length{};
+    };
+
+    // Decodes the codepoint at `i`. A sequence cut short by the end of `str` or by a
+    // byte that does not continue it decodes to U+FFFD and takes one byte.
+    constexpr auto decode(std::string_view str, std::size_t i) noexcept -> Decoded {
+        auto const b0 = static_cast<std::uint8_t>(str[i]);
+        if (b0 < 0x80) return { b0, 1 };
+
+        auto const len = get_length(str[i]);
+        if (len == 1 || i + len > str.size()) return { 0xfffd, 1 };
+        auto cp = static_cast<char32_t>(b0 & (0x7f >> len));
+        for (auto k = 1u; k < len; ++k) {
+            if (!is_continuation(str[i + k])) return { 0xfffd, 1 };
+            cp = (cp << 6) | (static_cast<std::uint8_t>(str[i + k]) & 0x3f);
+        }
+        return { cp, len };
+    }
+
+    namespace detail {
+        inline constexpr auto ones = std::uint64_t{0x0101010101010101};
+        inline constexpr auto high_bits = std::uint64_t{0x8080808080808080};
+
+        // Eight bytes of `str` from `i` as one word; byte order does not matter to the
+        // callers.
+        constexpr auto load(std::string_view str, std::size_t i) noexcept -> std::uint64_t {
+            if consteval {
+                auto w = std::uint64_t{};
+                for (auto k = 0u; k < 8; ++k) {
+                    w |= std::uint64_t{static_cast<std::uint8_t>(str[i + k])} << (k * 8);
+                }
+                return w;
+            } else {
+                auto w = std::uint64_t{};
+                std::memcpy(&w, str.data() + i, sizeof(w));
+                return w;
+            }
+        }
+
+        // Continuation bytes (0b10xxxxxx) in `w`.
+        constexpr auto count_continuations(std::uint64_t w) noexcept -> int {
+            return std::popcount(w & ~(w << 1) & high_bits);
+        }
+
+        // Whether some byte of `w` is below `n`, for `n` <= 128. Can report bytes after
+        // the first one below `n` that are not.
+        constexpr auto has_less(std::uint64_t w, std::uint8_t n) noexcept -> bool {
+            return ((w - ones * n) & ~w & high_bits) != 0;
+        }
+
+        constexpr auto is_ascii(std::uint64_t w) noexcept -> bool {
+            return (w & high_bits) == 0;
+        }
+    } // namespace detail
+
+    // Codepoints in `str`: every byte that does not continue a sequence starts one, so
+    // they are counted eight bytes at a time. Stray continuation bytes are not counted.
+    constexpr auto calculate_size(std::string_view str) noexcept -> std::size_t {
+        auto size = str.size();
+        auto i = std::size_t{};
+        for (; i + 32 <= str.size(); i += 32) {
+            size -= static_cast<std::size_t>(
+                detail::count_continuations(detail::load(str, i)) +
+                detail::count_continuations(detail::load(str, i + 8)) +
+                detail::count_continuations(detail::load(str, i + 16)) +
+                detail::count_continuations(detail::load(str, i + 24))
+            );
+        }
+        for (; i + 8 <= str.size(); i += 8) {
+            size -= static_cast<std::size_t>(detail::count_continuations(detail::load(str, i)));
+        }
+        for (; i < str.size(); ++i) {
+            size -= is_continuation(str[i]);
         }
         return size;
     }
+
+    // Offset of the first byte that is not part of a well-formed UTF-8 sequence, or
+    // `std::string_view::npos`. Overlong forms, surrogates and codepoints past U+10FFFF
+    // are rejected. ASCII is skipped eight bytes at a time.
+    constexpr auto find_invalid(std::string_view str) noexcept -> std::size_t {
+        auto i = std::size_t{};
+        while (i < str.size()) {
+            if (i + 8 <= str.size() && detail::is_ascii(detail::load(str, i))) {
+                i += 8;
+                continue;
+            }
+
+            auto const b0 = static_cast<std::uint8_t>(str[i]);
+            if (b0 < 0x80) {
+                ++i;
+                continue;
+            }
+
+            auto len = std::size_t{};
+            // Range of the second byte, which rules out overlong forms, surrogates and
+            // codepoints past U+10FFFF.
+            auto lo = std::uint8_t{0x80}, hi = std::uint8_t{0xbf};
+            if (b0 >= 0xc2 && b0 <= 0xdf) len = 2;
+            else if (b0 == 0xe0) len = 3, lo = 0xa0;
+            else if (b0 == 0xed) len = 3, hi = 0x9f;
+            else if (b0 >= 0xe1 && b0 <= 0xef) len = 3;
+            else if (b0 == 0xf0) len = 4, lo = 0x90;
+            else if (b0 == 0xf4) len = 4, hi = 0x8f;
+            else if (b0 >= 0xf1 && b0 <= 0xf3) len = 4;
+            else return i;
+
+            if (i + len > str.size()) return i;
+            auto const b1 = static_cast<std::uint8_t>(str[i + 1]);
+            if (b1 < lo || b1 > hi) return i;
+            for (auto k = 2ul; k < len; ++k) {
+                if (!is_continuation(str[i + k])) return i;
+            }
+            i += len;
+        }
+        return std::string_view::npos;
+    }
+
+    constexpr auto is_valid(std::string_view str) noexcept -> bool {
+        return find_invalid(str) == std::string_view::npos;
+    }
 } // namespace termml::core::utf8
 
 #endif // AMT_TERMML_CORE_UTF8_HPP
@@ -0,0 +1,211 @@
+#ifndef AMT_TERMML_CSS_SELECTOR_HPP
+#define AMT_TERMML_CSS_SELECTOR_HPP
+
+#include <cctype>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace termml::css {
+
+    // Calls `fn` for every whitespace separated word in `s`; used for `class` lists.
+    template <typename F>
+    constexpr auto for_each_word(std::string_view s, F&& fn) -> void {
+        auto i = std::size_t{};
+        while (i < s.size()) {
+            while (i < s.size() && std::isspace(static_cast<unsigned char>(s[i]))) ++i;
+            auto start = i;
+            while (i < s.size() && !std::isspace(static_cast<unsigned char>(s[i]))) ++i;
+            if (i > start) fn(s.substr(start, i - start));
+        }
+    }
+
+    enum class AttributeMatch: std::uint8_t {
+        Exists,     // [attr]
+        Equals,     // [attr=value]
+        Includes,   // [attr~=value], whitespace separated word
+        Prefix,     // [attr^=value]
+        Suffix,     // [attr$=value]
+        Substring   // [attr*=value]
+    };
+
+    struct AttributeSelector {
+        std::string_view name;
+        std::string_view value{};
+        AttributeMatch match{AttributeMatch::Exists};
+
+        constexpr auto matches(std::string_view v) const noexcept -> bool {
+            switch (match) {
+            case AttributeMatch::Exists: return true;
+            case AttributeMatch::Equals: return v == value;
+            case AttributeMatch::Prefix: return !value.empty() && v.starts_with(value);
+            case AttributeMatch::Suffix: return !value.empty() && v.ends_with(value);
+            case AttributeMatch::Substring: return !value.empty() && v.find(value) != std::string_view::npos;
+            case AttributeMatch::Includes: {
+                auto found = false;
+                for_each_word(v, [&found, this](std::string_view w) { found |= (w == value); });
+                return found;
+            }
+            }
+            return false;
+        }
+    };
+
+    enum class Combinator: std::uint8_t {
+        None,       // leftmost compound
+        Descendant, // "a b"
+        Child       // "a > b"
+    };
+
+    struct CompoundSelector {
+        // Empty matches any tag, as does "*".
+        std::string_view tag{};
+        std::string_view id{};
+        std::vector<std::string_view> classes{};
+        std::vector<AttributeSelector> attributes{};
+        // Relation to the compound on its left.
+        Combinator combinator{Combinator::None};
+
+        constexpr auto is_universal() const noexcept -> bool {
+            return tag.empty() || tag == "*";
+        }
+    };
+
+    // Parsed selector list. Supports type, universal, `#id`, `.class` and attribute
+    // selectors joined by descendant and child combinators, separated by commas.
+    // The selector keeps views into the string it was parsed from.
+    struct Selector {
+        // One entry per comma separated selector, each stored left to right.
+        std::vector<std::vector<CompoundSelector>> alternatives{};
+
+        // Malformed selectors parse to an empty list that matches nothing.
+        constexpr auto empty() const noexcept -> bool {
+            return alternatives.empty();
+        }
+
+        static constexpr auto parse(std::string_view source) -> Selector {
+            auto res = Selector{};
+            auto complex = std::vector<CompoundSelector>{};
+            auto pending = Combinator::None;
+            auto i = std::size_t{};
+
+            while (i < source.size()) {
+                auto c = source[i];
+                if (std::isspace(static_cast<unsigned char>(c))) {
+                    if (!complex.empty() && pending == Combinator::None) pending = Combinator::Descendant;
+                    ++i;
+                } else if (c == ',') {
+                    if (complex.empty() || pending == Combinator::Child) return {};
+                    res.alternatives.push_back(std::move(complex));
+                    complex.clear();
+                    pending = Combinator::None;
+                    ++i;
+                } else if (c == '>') {
+                    if (complex.empty() || pending == Combinator::Child) return {};
+                    pending = Combinator::Child;
+                    ++i;
+                } else {
+                    if (!complex.empty() && pending == Combinator::None) return {};
+                    auto compound = CompoundSelector{ .combinator = pending };
+                    if (!parse_compound(source, i, compound)) return {};
+                    complex.push_back(std::move(compound));
+                    pending = Combinator::None;
+                }
+            }
+
+            if (complex.empty() || pending == Combinator::Child) return {};
+            res.alternatives.push_back(std::move(complex));
+            return res;
+        }
+
+    private:
+        static constexpr auto is_identifier_char(char c) noexcept -> bool {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+        }
+
+        static constexpr auto parse_identifier(std::string_view source, std::size_t& i) noexcept -> std::string_view {
+            auto start = i;
+            while (i < source.size() && is_identifier_char(source[i])) ++i;
+            return source.substr(start, i - start);
+        }
+
+        static constexpr auto parse_compound(std::string_view source, std::size_t& i, CompoundSelector& out) -> bool {
+            auto start = i;
+            if (source[i] == '*') {
+                out.tag = source.substr(i++, 1);
+            } else {
+                out.tag = parse_identifier(source, i);
+            }
+
+            while (i < source.size()) {
+                auto c = source[i];
+                if (c == '#' || c == '.') {
+                    ++i;
+                    auto name = parse_identifier(source, i);
+                    if (name.empty()) return false;
+                    if (c == '#') out.id = name;
+                    else out.classes.push_back(name);
+                } else if (c == '[') {
+                    ++i;
+                    auto attr = AttributeSelector{};
+                    if (!parse_attribute(source, i, attr)) return false;
+                    out.attributes.push_back(attr);
+                } else {
+                    break;
+                }
+            }
+
+            return i != start;
+        }
+
+        // Parses the part after '[' up to and including ']'.
+        static constexpr auto parse_attribute(std::string_view source, std::size_t& i, AttributeSelector& out) -> bool {
+            auto skip_whitespace = [&] {
+                while (i < source.size() && std::isspace(static_cast<unsigned char>(source[i]))) ++i;
+            };
+
+            skip_whitespace();
+            out.name = parse_identifier(source, i);
+            if (out.name.empty()) return false;
+            skip_whitespace();
+            if (i >= source.size()) return false;
+
+            if (source[i] == ']') {
+                ++i;
+                return true;
+            }
+
+            switch (source[i]) {
+            case '=': out.match = AttributeMatch::Equals; break;
+            case '~': out.match = AttributeMatch::Includes; break;
+            case '^': out.match = AttributeMatch::Prefix; break;
+            case '$': out.match = AttributeMatch::Suffix; break;
+            case '*': out.match = AttributeMatch::Substring; break;
+            default: return false;
+            }
+            if (out.match != AttributeMatch::Equals) {
+                if (++i >= source.size() || source[i] != '=') return false;
+            }
+            ++i;
+            skip_whitespace();
+            if (i >= source.size()) return false;
+
+            if (auto quote = source[i]; quote == '"' || quote == '\'') {
+                auto end = source.find(quote, i + 1);
+                if (end == std::string_view::npos) return false;
+                out.value = source.substr(i + 1, end - i - 1);
+                i = end + 1;
+            } else {
+                out.value = parse_identifier(source, i);
+            }
+
+            skip_whitespace();
+            if (i >= source.size() || source[i] != ']') return false;
+            ++i;
+            return true;
+        }
+    };
+
+} // namespace termml::css
+
+#endif // AMT_TERMML_CSS_SELECTOR_HPP
@@ -4,13 +4,18 @@
 #include "../core/color_utils.hpp"
 #include "../core/string_utils.hpp"
 #include "utils.hpp"
+#include "../core/tag.hpp"
 #include <array>
-#include <charconv>
-#include <cstdlib>
+#include <cstdint>
+#include <memory_resource>
 #include <span>
 #include <unordered_map>
+#include <utility>
 
 namespace termml::css {
+    // Element attributes; values are views into the source or the document arena.
+    using attribute_map_t = std::pmr::unordered_map<std::string_view, std::string_view>;
+
     struct CSSPropertyKey {
         static constexpr std::string_view color = "color";
         static constexpr std::string_view background_color = "background-color";
@@ -60,17 +65,107 @@ namespace termml::css {
         static constexpr std::string_view overflow_x = "overflow_x";
         static constexpr std::string_view overflow_y = "overflow_y";
 
+        static constexpr std::string_view virtual_rows = "virtual-rows";
+
         static constexpr auto is_inheritable(std::string_view key) noexcept -> bool {
             if (key == color) return true;
             if (key == background_color) return true;
             if (key == whitespace) return true;
             return false;
         }
+    }; 
 
-        static constexpr std::array inherited_properties = {
-            color, background_color, whitespace
+    // Every property `Style::parse_proprties` understands. Doubles as the bit index
+    // into the mask of properties an element sets.
+    enum class PropertyId: std::uint8_t {
+        Color, BackgroundColor,
+        Padding, PaddingLeft, PaddingRight, PaddingTop, PaddingBottom,
+        Margin, MarginLeft, MarginRight, MarginTop, MarginBottom,
+        Width, MinWidth, MaxWidth, Height, MinHeight, MaxHeight,
+        Border, BorderLeft, BorderRight, BorderTop, BorderBottom,
+        BorderType, BorderTypeTopLeft, BorderTypeTopRight, BorderTypeBottomLeft, BorderTypeBottomRight,
+        Inset, Top, Left, Right, Bottom,
+        ZIndex, Display, Whitespace,
+        Overflow, OverflowX, OverflowY,
+        VirtualRows,
+        Unknown
+    };
+
+    static constexpr auto property_count = static_cast<std::size_t>(PropertyId::Unknown);
+
+    namespace detail {
+        // Indexed by `PropertyId`.
+        inline constexpr std::array<std::string_view, property_count> property_names = {
+            CSSPropertyKey::color, CSSPropertyKey::background_color,
+            CSSPropertyKey::padding, CSSPropertyKey::padding_left, CSSPropertyKey::padding_right,
+            CSSPropertyKey::padding_top, CSSPropertyKey::padding_bottom,
+            CSSPropertyKey::margin, CSSPropertyKey::margin_left, CSSPropertyKey::margin_right,
+            CSSPropertyKey::margin_top, CSSPropertyKey::margin_bottom,
+            CSSPropertyKey::width, CSSPropertyKey::min_width, CSSPropertyKey::max_width,
+            CSSPropertyKey::height, CSSPropertyKey::min_height, CSSPropertyKey::max_height,
+            CSSPropertyKey::border, CSSPropertyKey::border_left, CSSPropertyKey::border_right,
+            CSSPropertyKey::border_top, CSSPropertyKey::border_bottom,
+            CSSPropertyKey::border_type, CSSPropertyKey::border_type_top_left, CSSPropertyKey::border_type_top_right,
+            CSSPropertyKey::border_type_bottom_left, CSSPropertyKey::border_type_bottom_right,
+            CSSPropertyKey::inset, CSSPropertyKey::top, CSSPropertyKey::left,
+            CSSPropertyKey::right, CSSPropertyKey::bottom,
+            CSSPropertyKey::z_index, CSSPropertyKey::display, CSSPropertyKey::whitespace,
+            CSSPropertyKey::overflow, CSSPropertyKey::overflow_x, CSSPropertyKey::overflow_y,
+            CSSPropertyKey::virtual_rows,
         };
-    }; 
+
+        static constexpr auto property_hash(std::string_view key, std::uint32_t seed) noexcept -> std::uint32_t {
+            auto h = 2166136261u ^ seed;
+            for (auto c: key) {
+                h ^= static_cast<std::uint8_t>(c);
+                h *= 16777619u;
+            }
+            return h ^ (h >> 15);
+        }
+
+        // Perfect hash from property name to `PropertyId`: the seed is picked at compile
+        // time so that no two names share a slot, and a lookup is one hash and one compare.
+        struct PropertyHashTable {
+            static constexpr std::size_t size = 256;
+            static constexpr std::uint8_t empty = 0xff;
+
+            std::uint32_t seed{};
+            std::array<std::uint8_t, size> slots{};
+
+            constexpr auto find(std::string_view key) const noexcept -> PropertyId {
+                auto slot = slots[property_hash(key, seed) % size];
+                if (slot == empty || property_names[slot] != key) return PropertyId::Unknown;
+                return static_cast<PropertyId>(slot);
+            }
+        };
+
+        consteval auto make_property_hash_table() -> PropertyHashTable {
+            for (auto seed = 0u;; ++seed) {
+                auto table = PropertyHashTable{ .seed = seed };
+                table.slots.fill(PropertyHashTable::empty);
+
+                auto ok = true;
+                for (auto i = 0ul; i < property_count && ok; ++i) {
+                    auto& slot = table.slots[property_hash(property_names[i], seed) % PropertyHashTable::size];
+                    ok = slot == PropertyHashTable::empty;
+                    slot = static_cast<std::uint8_t>(i);
+                }
+                if (ok) return table;
+            }
+        }
+
+        inline constexpr auto property_hash_table = make_property_hash_table();
+    } // namespace detail
+
+    static constexpr auto property_id(std::string_view key) noexcept -> PropertyId {
+        return detail::property_hash_table.find(key);
+    }
+
+    // Whether `key` is a style property set to "inherit", which takes the parent's
+    // computed value.
+    static constexpr auto is_inherit(std::string_view key, std::string_view value) noexcept -> bool {
+        return core::utils::trim(value) == "inherit" && property_id(key) != PropertyId::Unknown;
+    }
 
     struct RGBColor {
         std::uint8_t r;
@@ -80,15 +175,42 @@ namespace termml::css {
         constexpr auto operator==(RGBColor const&) const noexcept -> bool = default;
     };
 
+    // Named slots of a `Palette`. Slots past these are free for the application and are
+    // referred to by number.
+    enum class PaletteSlot: std::uint8_t {
+        Foreground,
+        Background,
+        Primary,
+        Secondary,
+        Accent,
+        Muted,
+        Border,
+        Highlight,
+        Success,
+        Warning,
+        Error,
+        Info
+    };
+
+    namespace detail {
+        inline constexpr std::array<std::string_view, 12> palette_slot_names {
+            "foreground", "background", "primary", "secondary", "accent", "muted",
+            "border", "highlight", "success", "warning", "error", "info"
+        };
+    } // namespace detail
+
     struct Color {
         enum ColorKind: std::uint8_t {
             RGB,
             BIT4,
             BIT8,
-            TRANSPARENT
+            TRANSPARENT,
+            // Refers to a `Palette` slot; resolved when pixels are produced.
+            PALETTE
         };
 
         struct bit4_tag {};
+        struct palette_tag {};
 
         static const Color Black;
         static const Color Red;
@@ -133,6 +255,15 @@ namespace termml::css {
             , m_kind(Color::BIT4)
         {}
 
+        constexpr Color(std::uint8_t slot, palette_tag) noexcept
+            : m_data { .bit = slot }
+            , m_kind(Color::PALETTE)
+        {}
+
+        constexpr Color(PaletteSlot slot) noexcept
+            : Color(std::to_underlying(slot), palette_tag{})
+        {}
+
         constexpr auto as_rgb() const noexcept -> RGBColor {
             return m_data.rgb;
         };
@@ -145,6 +276,7 @@ namespace termml::css {
         constexpr auto is_8bit() const noexcept -> bool { return m_kind == BIT8; }
         constexpr auto is_4bit() const noexcept -> bool { return m_kind == BIT4; }
         constexpr auto is_transparent() const noexcept -> bool { return m_kind == TRANSPARENT; }
+        constexpr auto is_palette() const noexcept -> bool { return m_kind == PALETTE; }
 
         static constexpr auto parse(std::string_view c, Color def = Color::Default) noexcept -> Color {
             c = core::utils::trim(c);
@@ -152,6 +284,7 @@ namespace termml::css {
             // hex color -> rgb
             // named color -> bit4
             // bit8(xx) -> 8-bit color
+            // palette(name) or palette(xx) -> palette slot
 
             if (c.starts_with("#")) {
                 c = c.substr(1);
@@ -161,12 +294,12 @@ namespace termml::css {
                 auto k = 0ul;
                 std::array<std::uint8_t, 3> tmp{};
                 if (len % 2 == 1) {
-                    std::from_chars(c.data(), c.data() + 1, tmp[k++], 16);
+                    core::utils::parse_integer(c.substr(0, 1), tmp[k++], 16);
                     i += 1;
                 }
 
                 for (; i < len && k < 3; i += 2) {
-                    std::from_chars(c.data() + i, c.data() + i + 2, tmp[k++], 16);
+                    core::utils::parse_integer(c.substr(i, 2), tmp[k++], 16);
                 }
 
                 return Color(tmp[0], tmp[1], tmp[2]);
@@ -175,6 +308,19 @@ namespace termml::css {
                 std::array<std::uint8_t, 3> tmp{};
                 parse_args(c, std::span(tmp.data(), tmp.size()));
                 return Color(tmp[0], tmp[1], tmp[2]);
+            } else if (c.starts_with("palette")) {
+                c = c.substr(7);
+                auto open = c.find('(');
+                auto close = c.find(')');
+                if (open == std::string_view::npos || close == std::string_view::npos || close < open) return def;
+                auto name = core::utils::trim(c.substr(open + 1, close - open - 1));
+                for (auto i = 0ul; i < detail::palette_slot_names.size(); ++i) {
+                    if (detail::palette_slot_names[i] == name) return Color(static_cast<std::uint8_t>(i), palette_tag{});
+                }
+                std::array<std::uint8_t, 1> tmp{};
+                if (name.empty() || !core::utils::is_digit(name[0])) return def;
+                parse_args(name, std::span(tmp.data(), tmp.size()));
+                return Color(tmp[0], palette_tag{});
             } else if (c.starts_with("bit")) {
                 c = c.substr(3);
                 std::array<std::uint8_t, 1> tmp{};
@@ -221,33 +367,25 @@ namespace termml::css {
         static constexpr auto parse_args(std::string_view c, std::span<T> out, int base = 10) noexcept -> void {
             auto k = 0ul;
             auto i = 0ul;
-            char buffer[64]{};
-            auto len = std::min<std::size_t>(c.size(), 63);
-            std::copy_n(c.begin(), len, buffer);
-            buffer[len] = 0;
-
-            c = std::string_view(buffer, len);
 
-            // TODO: To better float parsing.
             while (k < out.size() && i < c.size()) {
                 if (c[i] == ')') return;
                 for (; i < c.size(); ++i) {
                     auto t = c[i];
                     if (t == ')') return;
-                    if (std::isdigit(t) || t == '.') break;
+                    if (core::utils::is_digit(t) || t == '.') break;
                 }
 
                 auto start = i;
 
                 for (; i < c.size(); ++i) {
-                    if (!std::isdigit(c[i]) && c[i] != '.') break;
+                    if (!core::utils::is_digit(c[i]) && c[i] != '.') break;
                 }
 
                 if constexpr (std::is_integral_v<T>) {
-                    std::from_chars(c.data() + start, c.data() + i, out[k++], base);
+                    core::utils::parse_integer(c.substr(start, i - start), out[k++], base);
                 } else {
-                    char* end{};
-                    out[k++] = std::strtof(c.data() + start, &end);
+                    out[k++] = core::utils::parse_float(c.substr(start, i - start));
                 }
             }
         }
@@ -259,24 +397,58 @@ namespace termml::css {
         ColorKind m_kind{};
     };
 
-    inline constexpr auto Color::Black              = Color{ 0, Color::bit4_tag{} };
-    inline constexpr auto Color::Red                = Color{ 1, Color::bit4_tag{} };
-    inline constexpr auto Color::Green              = Color{ 2, Color::bit4_tag{} };
-    inline constexpr auto Color::Yellow             = Color{ 3, Color::bit4_tag{} };
-    inline constexpr auto Color::Blue               = Color{ 4, Color::bit4_tag{} };
-    inline constexpr auto Color::Magenta            = Color{ 5, Color::bit4_tag{} };
-    inline constexpr auto Color::Cyan               = Color{ 6, Color::bit4_tag{} };
-    inline constexpr auto Color::White              = Color{ 7, Color::bit4_tag{} };
-    inline constexpr auto Color::BrightBlack        = Color{ 8, Color::bit4_tag{} };
-    inline constexpr auto Color::BrightRed          = Color{ 9, Color::bit4_tag{} };
-    inline constexpr auto Color::BrightGreen        = Color{10, Color::bit4_tag{} };
-    inline constexpr auto Color::BrightYellow       = Color{11, Color::bit4_tag{} };
-    inline constexpr auto Color::BrightBlue         = Color{12, Color::bit4_tag{} };
-    inline constexpr auto Color::BrightMagenta      = Color{13, Color::bit4_tag{} };
-    inline constexpr auto Color::BrightCyan         = Color{14, Color::bit4_tag{} };
-    inline constexpr auto Color::BrightWhite        = Color{15, Color::bit4_tag{} };
-    inline constexpr auto Color::Default            = Color{16, Color::bit4_tag{} };
-    inline constexpr auto Color::Transparent        = Color{};
+    inline constexpr Color Color::Black              = Color{ 0, Color::bit4_tag{} };
+    inline constexpr Color Color::Red                = Color{ 1, Color::bit4_tag{} };
+    inline constexpr Color Color::Green              = Color{ 2, Color::bit4_tag{} };
+    inline constexpr Color Color::Yellow             = Color{ 3, Color::bit4_tag{} };
+    inline constexpr Color Color::Blue               = Color{ 4, Color::bit4_tag{} };
+    inline constexpr Color Color::Magenta            = Color{ 5, Color::bit4_tag{} };
+    inline constexpr Color Color::Cyan               = Color{ 6, Color::bit4_tag{} };
+    inline constexpr Color Color::White              = Color{ 7, Color::bit4_tag{} };
+    inline constexpr Color Color::BrightBlack        = Color{ 8, Color::bit4_tag{} };
+    inline constexpr Color Color::BrightRed          = Color{ 9, Color::bit4_tag{} };
+    inline constexpr Color Color::BrightGreen        = Color{10, Color::bit4_tag{} };
+    inline constexpr Color Color::BrightYellow       = Color{11, Color::bit4_tag{} };
+    inline constexpr Color Color::BrightBlue         = Color{12, Color::bit4_tag{} };
+    inline constexpr Color Color::BrightMagenta      = Color{13, Color::bit4_tag{} };
+    inline constexpr Color Color::BrightCyan         = Color{14, Color::bit4_tag{} };
+    inline constexpr Color Color::BrightWhite        = Color{15, Color::bit4_tag{} };
+    inline constexpr Color Color::Default            = Color{16, Color::bit4_tag{} };
+    inline constexpr Color Color::Transparent        = Color{};
+
+    // Concrete colors for `palette(...)` references. Styles keep the reference, and it is
+    // looked up only when pixels are produced, so switching themes is a palette swap
+    // and a repaint. Every slot starts out as the terminal's default color, except the
+    // named ones, which map to the basic colors.
+    struct Palette {
+        std::array<Color, 256> colors;
+
+        constexpr Palette() noexcept {
+            colors.fill(Color::Default);
+            set(PaletteSlot::Primary, Color::Blue);
+            set(PaletteSlot::Secondary, Color::Cyan);
+            set(PaletteSlot::Accent, Color::Magenta);
+            set(PaletteSlot::Muted, Color::BrightBlack);
+            set(PaletteSlot::Highlight, Color::Yellow);
+            set(PaletteSlot::Success, Color::Green);
+            set(PaletteSlot::Warning, Color::Yellow);
+            set(PaletteSlot::Error, Color::Red);
+            set(PaletteSlot::Info, Color::Cyan);
+        }
+
+        // Slots cannot refer to other slots; such colors resolve to the default.
+        constexpr auto set(std::uint8_t slot, Color color) noexcept -> void {
+            colors[slot] = color.is_palette() ? Color::Default : color;
+        }
+
+        constexpr auto set(PaletteSlot slot, Color color) noexcept -> void {
+            set(std::to_underlying(slot), color);
+        }
+
+        constexpr auto resolve(Color color) const noexcept -> Color {
+            return color.is_palette() ? colors[color.as_bit()] : color;
+        }
+    };
 
 
     enum class Unit {
@@ -297,8 +469,7 @@ namespace termml::css {
             if (s.empty() || s == "fit") return def;
 
             if (s.ends_with('%')) {
-                char* end{};
-                float tmp = std::strtof(s.data(), &end);
+                float tmp = core::utils::parse_float(s);
                 return { .f = tmp, .unit = Unit::Percentage };
             } else {
                 auto i = int{};
@@ -311,9 +482,9 @@ namespace termml::css {
                 if (s.empty()) return def;
 
                 for (; j < s.size(); ++j) {
-                    if (!std::isdigit(s[j])) break;
+                    if (!core::utils::is_digit(s[j])) break;
                 }
-                std::from_chars(s.data(), s.data() + j, i);
+                core::utils::parse_integer(s.substr(0, j), i);
                 auto u = s.substr(j);
                 if (u == "px" || u == "c" || u == "cell") {
                     return { .i = is_neg ? -i : i, .unit = Unit::Cell };
@@ -405,19 +576,19 @@ namespace termml::css {
         auto i = 0ul;
 
         for (; i < s.size(); ++i) {
-            if (!std::isspace(s[i])) break;
+            if (!core::utils::is_space(s[i])) break;
         }
 
         for (; i < s.size() && k < 4;) {
             auto start = i;
             for (; i < s.size(); ++i) {
-                if (std::isspace(s[i])) break;
+                if (core::utils::is_space(s[i])) break;
             }
 
             tmp[k++] = Number::parse(s.substr(start, i - start), Number::min());
 
             for (; i < s.size(); ++i) {
-                if (!std::isspace(s[i])) break;
+                if (!core::utils::is_space(s[i])) break;
             }
         }
 
@@ -481,7 +652,7 @@ namespace termml::css {
             //     width = Number::parse(s.substr(0, i));
             //
             //     for (; i < s.size(); ++i) {
-            //         if (!std::isspace(s[i])) break;
+            //         if (!core::utils::is_space(s[i])) break;
             //     }
             //     s = s.substr(i);
             // }
@@ -490,13 +661,13 @@ namespace termml::css {
             // border: solid red
             auto i = std::size_t{};
             for (; i < s.size(); ++i) {
-                if (std::isspace(s[i])) break;
+                if (core::utils::is_space(s[i])) break;
             }
 
             auto style = parse_border_style(s.substr(0, i));
 
             for (; i < s.size(); ++i) {
-                if (!std::isspace(s[i])) break;
+                if (!core::utils::is_space(s[i])) break;
             }
 
             auto color = Color::parse(s.substr(std::min(i, s.size())));
@@ -566,7 +737,10 @@ namespace termml::css {
         }
     };
 
-    inline static constexpr auto parse_border_type(std::string_view s, BorderType def = BorderType::Sharp) noexcept -> std::tuple<BorderType, BorderType, BorderType, BorderType> {
+    // top-left, top-right, bottom-right, bottom-left
+    using border_types_t = std::array<BorderType, 4>;
+
+    inline static constexpr auto parse_border_type(std::string_view s, BorderType def = BorderType::Sharp) noexcept -> border_types_t {
         s = core::utils::trim(s);
         if (s.empty()) return { def, def, def, def };
 
@@ -575,13 +749,13 @@ namespace termml::css {
         auto i = 0ul;
 
         for (; i < s.size(); ++i) {
-            if (!std::isspace(s[i])) break;
+            if (!core::utils::is_space(s[i])) break;
         }
 
         for (; i < s.size() && k < 4;) {
             auto start = i;
             for (; i < s.size(); ++i) {
-                if (std::isspace(s[i])) break;
+                if (core::utils::is_space(s[i])) break;
             }
 
             auto text = s.substr(start, i - start);
@@ -592,15 +766,15 @@ namespace termml::css {
             }
 
             for (; i < s.size(); ++i) {
-                if (!std::isspace(s[i])) break;
+                if (!core::utils::is_space(s[i])) break;
             }
         }
 
         switch (k) {
-            case 1: return std::make_tuple(tmp[0], tmp[0], tmp[0], tmp[0]);
-            case 2: return std::make_tuple(tmp[0], tmp[1], tmp[0], tmp[1]);
-            case 3: return std::make_tuple(tmp[0], tmp[1], tmp[2], BorderType::Sharp);
-            case 4: return std::make_tuple(tmp[0], tmp[1], tmp[2], tmp[3]);
+            case 1: return border_types_t{ tmp[0], tmp[0], tmp[0], tmp[0] };
+            case 2: return border_types_t{ tmp[0], tmp[1], tmp[0], tmp[1] };
+            case 3: return border_types_t{ tmp[0], tmp[1], tmp[2], BorderType::Sharp };
+            case 4: return border_types_t{ tmp[0], tmp[1], tmp[2], tmp[3] };
         }
 
         std::unreachable();
@@ -678,12 +852,7 @@ namespace termml::css {
         Border border_bottom{};
         Border border_left{};
 
-        std::tuple<
-            BorderType /*tl*/,
-            BorderType /*tr*/,
-            BorderType /*br*/,
-            BorderType /*bl*/
-        > border_type{ BorderType::Sharp, BorderType::Sharp, BorderType::Sharp, BorderType::Sharp };
+        border_types_t border_type{ BorderType::Sharp, BorderType::Sharp, BorderType::Sharp, BorderType::Sharp };
 
         QuadProperty padding{};
         QuadProperty margin{};
@@ -694,6 +863,11 @@ namespace termml::css {
         Overflow overflow_x{Overflow::Visible};
         Overflow overflow_y{Overflow::Visible};
 
+        // Cells a child is assumed to take up before it is laid out, when the element is a
+        // virtual list: its children are rows and only the ones in view are laid out.
+        // Zero otherwise.
+        int virtual_rows{};
+
         Color fg_color{Color::Default};
         Color bg_color{Color::Default};
 
@@ -702,21 +876,61 @@ namespace termml::css {
 
         TextStyle text_style{};
 
+        // `props` is any range of key/value pairs, so styles can also be computed from a
+        // compiled template at compile time. The attributes are walked once and sorted
+        // into slots by `property_id`; groups of properties the element does not set are
+        // skipped, so the cost follows the attributes present rather than the properties
+        // supported. Shorthands are still applied before their longhands.
+        template <typename Props = attribute_map_t>
         constexpr auto parse_proprties(
-            std::string_view tag,
-            std::unordered_map<std::string_view, std::string_view> const& props,
+            core::TagId tag,
+            Props const& props,
             Style const* parent = nullptr
         ) noexcept -> void {
+            auto values = std::array<std::string_view, property_count>{};
+            auto present = std::uint64_t{};
+            // Properties set to "inherit" take the parent's computed value; without a parent
+            // they keep their defaults.
+            auto inherited = std::uint64_t{};
+            for (auto const& [k, v]: props) {
+                auto id = std::to_underlying(property_id(k));
+                if (id == std::to_underlying(PropertyId::Unknown)) continue;
+                auto const bit = std::uint64_t{1} << id;
+                if (core::utils::trim(v) == "inherit") {
+                    values[id] = {};
+                    present &= ~bit;
+                    inherited |= bit;
+                    continue;
+                }
+                values[id] = v;
+                present |= bit;
+                inherited &= ~bit;
+            }
+            if (!parent) inherited = 0;
+            auto get = [&values](PropertyId id) { return values[std::to_underlying(id)]; };
+            // True if any property in [first, last] is set.
+            auto any = [present](PropertyId first, PropertyId last) {
+                auto const lo = std::to_underlying(first);
+                auto const hi = std::to_underlying(last);
+                auto const mask = ((std::uint64_t{2} << (hi - lo)) - 1) << lo;
+                return (present & mask) != 0;
+            };
 
             {
-                auto d = core::utils::trim(get_property(props, CSSPropertyKey::display));
-                if (d == "block") display = Display::Block;
+                auto d = core::utils::trim(get(PropertyId::Display));
+                if (inherited & (std::uint64_t{1} << std::to_underlying(PropertyId::Display))) display = parent->display;
+                else if (d == "block") display = Display::Block;
                 else if (d == "inline") display = Display::Inline;
                 else if (d == "inline-block") display = Display::InlineBlock;
                 else if (d == "flex") display = Display::Flex;
                 else {
-                    if (tag == "text" || tag == "span" || tag == "em") display = Display::Inline;
-                    else if (tag == "b" || tag == "strong" || tag == "i") display = Display::Inline;
+                    using core::TagId;
+                    switch (tag) {
+                    case TagId::Text: case TagId::Span: case TagId::Em:
+                    case TagId::B: case TagId::Strong: case TagId::I:
+                        display = Display::Inline; break;
+                    default: break;
+                    }
                 }
 
                 if (parent) {
@@ -729,22 +943,22 @@ namespace termml::css {
             }
 
             fg_color = Color::parse(
-                get_property(props, CSSPropertyKey::color),
+                get(PropertyId::Color),
                 parent ? parent->fg_color : Color::Default
             );
 
             bg_color = Color::parse(
-                get_property(props, CSSPropertyKey::background_color),
+                get(PropertyId::BackgroundColor),
                 parent ? parent->bg_color : Color::Default
             );
 
             // padding
-            {
-                auto tp = get_property(props, CSSPropertyKey::padding); 
-                auto tp_top = get_property(props, CSSPropertyKey::padding_top); 
-                auto tp_right = get_property(props, CSSPropertyKey::padding_right); 
-                auto tp_bottom = get_property(props, CSSPropertyKey::padding_bottom); 
-                auto tp_left = get_property(props, CSSPropertyKey::padding_left); 
+            if (any(PropertyId::Padding, PropertyId::PaddingBottom)) {
+                auto tp = get(PropertyId::Padding); 
+                auto tp_top = get(PropertyId::PaddingTop); 
+                auto tp_right = get(PropertyId::PaddingRight); 
+                auto tp_bottom = get(PropertyId::PaddingBottom); 
+                auto tp_left = get(PropertyId::PaddingLeft); 
                 if (!tp.empty()) {
                     padding = parse_quad_values(tp);
                 }
@@ -763,12 +977,12 @@ namespace termml::css {
             }
 
             // margin
-            {
-                auto tm = get_property(props, CSSPropertyKey::margin); 
-                auto tm_top = get_property(props, CSSPropertyKey::margin_top); 
-                auto tm_right = get_property(props, CSSPropertyKey::margin_right); 
-                auto tm_bottom = get_property(props, CSSPropertyKey::margin_bottom); 
-                auto tm_left = get_property(props, CSSPropertyKey::margin_left); 
+            if (any(PropertyId::Margin, PropertyId::MarginBottom)) {
+                auto tm = get(PropertyId::Margin); 
+                auto tm_top = get(PropertyId::MarginTop); 
+                auto tm_right = get(PropertyId::MarginRight); 
+                auto tm_bottom = get(PropertyId::MarginBottom); 
+                auto tm_left = get(PropertyId::MarginLeft); 
                 if (!tm.empty()) {
                     margin = parse_quad_values(tm);
                 }
@@ -787,12 +1001,12 @@ namespace termml::css {
             }
 
             // border
-            {
-                auto tb = get_property(props, CSSPropertyKey::border); 
-                auto tb_top = get_property(props, CSSPropertyKey::border_top); 
-                auto tb_right = get_property(props, CSSPropertyKey::border_right); 
-                auto tb_bottom = get_property(props, CSSPropertyKey::border_bottom); 
-                auto tb_left = get_property(props, CSSPropertyKey::border_left); 
+            if (any(PropertyId::Border, PropertyId::BorderTypeBottomRight)) {
+                auto tb = get(PropertyId::Border); 
+                auto tb_top = get(PropertyId::BorderTop); 
+                auto tb_right = get(PropertyId::BorderRight); 
+                auto tb_bottom = get(PropertyId::BorderBottom); 
+                auto tb_left = get(PropertyId::BorderLeft); 
                 if (!tb.empty()) {
                     // TODO: add support for multiple border parsing separated by ','
                     auto b = Border::parse(tb);
@@ -814,11 +1028,11 @@ namespace termml::css {
                     border_left = Border::parse(tb_left);
                 }
 
-                auto bt = get_property(props, CSSPropertyKey::border_type);
-                auto bt_tl = get_property(props, CSSPropertyKey::border_type_top_left);
-                auto bt_tr = get_property(props, CSSPropertyKey::border_type_top_right);
-                auto bt_br = get_property(props, CSSPropertyKey::border_type_bottom_right);
-                auto bt_bl = get_property(props, CSSPropertyKey::border_type_bottom_left);
+                auto bt = get(PropertyId::BorderType);
+                auto bt_tl = get(PropertyId::BorderTypeTopLeft);
+                auto bt_tr = get(PropertyId::BorderTypeTopRight);
+                auto bt_br = get(PropertyId::BorderTypeBottomRight);
+                auto bt_bl = get(PropertyId::BorderTypeBottomLeft);
 
                 if (!bt.empty()) {
                     auto b = parse_border_type(bt);
@@ -846,12 +1060,12 @@ namespace termml::css {
             }
 
             // insert
-            {
-                auto ti = get_property(props, CSSPropertyKey::inset); 
-                auto ti_top = get_property(props, CSSPropertyKey::top); 
-                auto ti_right = get_property(props, CSSPropertyKey::right); 
-                auto ti_bottom = get_property(props, CSSPropertyKey::bottom); 
-                auto ti_left = get_property(props, CSSPropertyKey::left); 
+            if (any(PropertyId::Inset, PropertyId::Bottom)) {
+                auto ti = get(PropertyId::Inset); 
+                auto ti_top = get(PropertyId::Top); 
+                auto ti_right = get(PropertyId::Right); 
+                auto ti_bottom = get(PropertyId::Bottom); 
+                auto ti_left = get(PropertyId::Left); 
                 if (!ti.empty()) {
                     inset = parse_quad_values(ti);
                 }
@@ -869,7 +1083,7 @@ namespace termml::css {
                 }
             }
 
-            auto tw = get_property(props, CSSPropertyKey::width);
+            auto tw = get(PropertyId::Width);
             if (!tw.empty()) {
                 width = Number::parse(tw);
             } else {
@@ -878,42 +1092,42 @@ namespace termml::css {
                 }
             }
 
-            auto th = get_property(props, CSSPropertyKey::height);
+            auto th = get(PropertyId::Height);
             if (!th.empty()) {
                 height = Number::parse(th);
             }
 
             min_width = Number::parse(
-                get_property(props, CSSPropertyKey::min_width),
+                get(PropertyId::MinWidth),
                 Number::min()
             );
 
             min_height = Number::parse(
-                get_property(props, CSSPropertyKey::min_height),
+                get(PropertyId::MinHeight),
                 Number::min()
             );
 
             max_width = Number::parse(
-                get_property(props, CSSPropertyKey::max_width),
+                get(PropertyId::MaxWidth),
                 Number::max()
             );
 
             max_height = Number::parse(
-                get_property(props, CSSPropertyKey::max_height),
+                get(PropertyId::MaxHeight),
                 Number::max()
             );
 
             {
-                auto tz = Number::parse(get_property(props, CSSPropertyKey::z_index));
+                auto tz = Number::parse(get(PropertyId::ZIndex));
                 if (tz.is_absolute()) {
                     z_index = tz.i;
                 }
             }
 
-            {
-                auto to = core::utils::trim(get_property(props, CSSPropertyKey::overflow));
-                auto to_x = get_property(props, CSSPropertyKey::overflow_x);
-                auto to_y = get_property(props, CSSPropertyKey::overflow_y);
+            if (any(PropertyId::Overflow, PropertyId::OverflowY)) {
+                auto to = core::utils::trim(get(PropertyId::Overflow));
+                auto to_x = get(PropertyId::OverflowX);
+                auto to_y = get(PropertyId::OverflowY);
 
                 if (!to.empty()) {
                     auto space_pos = to.find(' ');
@@ -929,9 +1143,21 @@ namespace termml::css {
                     overflow_y = parse_overflow(to_y, overflow_y);
                 }
             }
+
+            // virtual-rows: `auto` for one cell per row, or a length in cells.
+            {
+                auto tv = core::utils::trim(get(PropertyId::VirtualRows));
+                if (tv == "auto") {
+                    virtual_rows = 1;
+                } else if (auto rows = Number::parse(tv); rows.is_absolute()) {
+                    virtual_rows = std::max(rows.i, 1);
+                }
+            }
             // white-space
             {
-                auto ws = core::utils::trim(get_property(props, CSSPropertyKey::whitespace));
+                // Inherited, also when the parent got it from a stylesheet rule.
+                if (parent) whitespace = parent->whitespace;
+                auto ws = core::utils::trim(get(PropertyId::Whitespace));
 
                 if (ws == "normal") whitespace = Whitespace::Normal;
                 else if (ws == "nowrap") whitespace = Whitespace::NoWrap;
@@ -942,10 +1168,12 @@ namespace termml::css {
 
             // text style
             {
-                text_style.bold = (tag == "b");
-                text_style.italic = (tag == "i");
+                text_style.bold = (tag == core::TagId::B);
+                text_style.italic = (tag == core::TagId::I);
             }
 
+            if (inherited) inherit_properties(*parent, inherited, present);
+
             if (display == Display::Inline) {
                 width = Number::fit();
                 height = Number::fit();
@@ -958,6 +1186,58 @@ namespace termml::css {
             }
         }
 
+        // Copies the properties in `inherited`, a bit per `PropertyId`, from `parent`. An
+        // inherited shorthand leaves the sides whose longhand is set in `present`.
+        constexpr auto inherit_properties(Style const& parent, std::uint64_t inherited, std::uint64_t present) noexcept -> void {
+            auto bit = [](PropertyId id) { return std::uint64_t{1} << std::to_underlying(id); };
+            auto has = [&](PropertyId id) { return (inherited & bit(id)) != 0; };
+            // A side inherits through its longhand or through a shorthand it is not set apart from.
+            auto side = [&](PropertyId shorthand, PropertyId longhand) {
+                return has(longhand) || (has(shorthand) && (present & bit(longhand)) == 0);
+            };
+
+            if (has(PropertyId::Color)) fg_color = parent.fg_color;
+            if (has(PropertyId::BackgroundColor)) bg_color = parent.bg_color;
+
+            if (side(PropertyId::Padding, PropertyId::PaddingLeft)) padding.left = parent.padding.left;
+            if (side(PropertyId::Padding, PropertyId::PaddingRight)) padding.right = parent.padding.right;
+            if (side(PropertyId::Padding, PropertyId::PaddingTop)) padding.top = parent.padding.top;
+            if (side(PropertyId::Padding, PropertyId::PaddingBottom)) padding.bottom = parent.padding.bottom;
+
+            if (side(PropertyId::Margin, PropertyId::MarginLeft)) margin.left = parent.margin.left;
+            if (side(PropertyId::Margin, PropertyId::MarginRight)) margin.right = parent.margin.right;
+            if (side(PropertyId::Margin, PropertyId::MarginTop)) margin.top = parent.margin.top;
+            if (side(PropertyId::Margin, PropertyId::MarginBottom)) margin.bottom = parent.margin.bottom;
+
+            if (has(PropertyId::Width)) width = parent.width;
+            if (has(PropertyId::MinWidth)) min_width = parent.min_width;
+            if (has(PropertyId::MaxWidth)) max_width = parent.max_width;
+            if (has(PropertyId::Height)) height = parent.height;
+            if (has(PropertyId::MinHeight)) min_height = parent.min_height;
+            if (has(PropertyId::MaxHeight)) max_height = parent.max_height;
+
+            if (side(PropertyId::Border, PropertyId::BorderLeft)) border_left = parent.border_left;
+            if (side(PropertyId::Border, PropertyId::BorderRight)) border_right = parent.border_right;
+            if (side(PropertyId::Border, PropertyId::BorderTop)) border_top = parent.border_top;
+            if (side(PropertyId::Border, PropertyId::BorderBottom)) border_bottom = parent.border_bottom;
+
+            if (side(PropertyId::BorderType, PropertyId::BorderTypeTopLeft)) std::get<0>(border_type) = std::get<0>(parent.border_type);
+            if (side(PropertyId::BorderType, PropertyId::BorderTypeTopRight)) std::get<1>(border_type) = std::get<1>(parent.border_type);
+            if (side(PropertyId::BorderType, PropertyId::BorderTypeBottomRight)) std::get<2>(border_type) = std::get<2>(parent.border_type);
+            if (side(PropertyId::BorderType, PropertyId::BorderTypeBottomLeft)) std::get<3>(border_type) = std::get<3>(parent.border_type);
+
+            if (side(PropertyId::Inset, PropertyId::Left)) inset.left = parent.inset.left;
+            if (side(PropertyId::Inset, PropertyId::Right)) inset.right = parent.inset.right;
+            if (side(PropertyId::Inset, PropertyId::Top)) inset.top = parent.inset.top;
+            if (side(PropertyId::Inset, PropertyId::Bottom)) inset.bottom = parent.inset.bottom;
+
+            if (has(PropertyId::ZIndex)) z_index = parent.z_index;
+            if (has(PropertyId::Whitespace)) whitespace = parent.whitespace;
+            if (side(PropertyId::Overflow, PropertyId::OverflowX)) overflow_x = parent.overflow_x;
+            if (side(PropertyId::Overflow, PropertyId::OverflowY)) overflow_y = parent.overflow_y;
+            if (has(PropertyId::VirtualRows)) virtual_rows = parent.virtual_rows;
+        }
+
         constexpr auto content_width() const noexcept -> int {
             auto w = width.as_cell();
             auto b = border_left.border_width() + border_right.border_width();
@@ -1017,16 +1297,115 @@ namespace termml::css {
             if (item_type == ItemType::None) return true;
             return false;
         }
-    private:
-        static constexpr auto get_property(
-            std::unordered_map<std::string_view, std::string_view> const& props,
-            std::string_view key
-        ) noexcept -> std::string_view {
-            if (auto it = props.find(key); it != props.end()) {
-                return it->second;
-            } else {
-                return {};
-            }
+    };
+
+    // The part of a `Style` layout reads and resolves used values into. Layout passes
+    // walk every node's record, so it is kept apart from the paint-only properties.
+    struct LayoutStyle {
+        Number min_width{ Number::min() };
+        Number max_width{ Number::max() };
+
+        Number min_height{ Number::min() };
+        Number max_height{ Number::max() };
+
+        Number width { Number::fit() };
+        Number height { Number::fit() };
+
+        QuadProperty padding{};
+        QuadProperty margin{};
+        QuadProperty inset{};
+
+        // Cells taken by each border; see `Border::border_width`.
+        std::int8_t border_top_width{};
+        std::int8_t border_right_width{};
+        std::int8_t border_bottom_width{};
+        std::int8_t border_left_width{};
+
+        Display display{Display::Block};
+        ItemType item_type{ItemType::None};
+
+        Overflow overflow_x{Overflow::Visible};
+        Overflow overflow_y{Overflow::Visible};
+
+        Whitespace whitespace{Whitespace::Normal};
+        OverflowWrap overflow_wrap{OverflowWrap::Normal};
+
+        int virtual_rows{};
+
+        static constexpr auto from(Style const& s) noexcept -> LayoutStyle {
+            return {
+                .min_width = s.min_width,
+                .max_width = s.max_width,
+                .min_height = s.min_height,
+                .max_height = s.max_height,
+                .width = s.width,
+                .height = s.height,
+                .padding = s.padding,
+                .margin = s.margin,
+                .inset = s.inset,
+                .border_top_width = static_cast<std::int8_t>(s.border_top.border_width()),
+                .border_right_width = static_cast<std::int8_t>(s.border_right.border_width()),
+                .border_bottom_width = static_cast<std::int8_t>(s.border_bottom.border_width()),
+                .border_left_width = static_cast<std::int8_t>(s.border_left.border_width()),
+                .display = s.display,
+                .item_type = s.item_type,
+                .overflow_x = s.overflow_x,
+                .overflow_y = s.overflow_y,
+                .whitespace = s.whitespace,
+                .overflow_wrap = s.overflow_wrap,
+                .virtual_rows = s.virtual_rows
+            };
+        }
+
+        constexpr auto content_width() const noexcept -> int {
+            auto w = width.as_cell();
+            auto b = border_left_width + border_right_width;
+            auto p = padding.left.as_cell() + padding.right.as_cell();
+            return std::max(
+                0,
+                w - (b + p)
+            );
+        }
+
+        constexpr auto has_inline_flow() const noexcept -> bool { return Style::has_inline_flow(display); }
+        constexpr auto is_inline_context() const noexcept -> bool { return Style::is_inline_context(display); }
+        constexpr auto has_start_whitespace() const noexcept -> bool { return Style::has_start_whitespace(padding); }
+        constexpr auto has_end_whitespace() const noexcept -> bool { return Style::has_end_whitespace(padding); }
+
+        constexpr auto can_collapse_margin() const noexcept -> bool {
+            return item_type == ItemType::None;
+        }
+
+        constexpr auto is_virtual_list() const noexcept -> bool { return virtual_rows != 0; }
+    };
+
+    // The part of a `Style` only painting reads.
+    struct PaintStyle {
+        Border border_top{};
+        Border border_right{};
+        Border border_bottom{};
+        Border border_left{};
+
+        border_types_t border_type{ BorderType::Sharp, BorderType::Sharp, BorderType::Sharp, BorderType::Sharp };
+
+        Color fg_color{Color::Default};
+        Color bg_color{Color::Default};
+
+        TextStyle text_style{};
+        int z_index{};
+
+        static constexpr auto from(Style const& s) noexcept -> PaintStyle {
+            return {
+                .border_top = s.border_top,
+                .border_right = s.border_right,
+                .border_bottom = s.border_bottom,
+                .border_left = s.border_left,
+                .border_type = s.border_type,
+                .fg_color = s.fg_color,
+                .bg_color = s.bg_color,
+                .text_style = s.text_style,
+                .z_index = s.z_index
+            };
         }
     };
 } // namespace termml::css
@@ -1070,6 +1449,8 @@ struct std::formatter<termml::css::Color> {
             std::format_to(out, "Bit({})", int(c.as_bit()));
         } else if (c.is_transparent()) {
             std::format_to(out, "transparent");
+        } else if (c.is_palette()) {
+            std::format_to(out, "Palette({})", int(c.as_bit()));
         }
         return out;
     }
@@ -1273,17 +1654,76 @@ struct std::formatter<termml::css::Style> {
         std::format_to(out, "border-bottom: {}, ", v.border_bottom);
         std::format_to(out, "border-left: {}, ", v.border_left);
 
-        std::format_to(out, "border_type: {}, ", v.border_type);
+        auto [tl, tr, br, bl] = v.border_type;
+        std::format_to(out, "border_type: ({}, {}, {}, {}), ", tl, tr, br, bl);
 
         std::format_to(out, "padding: ({}), ", v.padding);
 
         std::format_to(out, "z-index: {}, ", v.z_index);
         std::format_to(out, "white-space: {}, ", v.whitespace);
         std::format_to(out, "overflow: (x: {}, y: {}), ", v.overflow_x, v.overflow_y);
+        if (v.virtual_rows != 0) std::format_to(out, "virtual-rows: {}, ", v.virtual_rows);
         std::format_to(out, "color: {}, bg-color: {}", v.fg_color, v.bg_color);
 
         std::format_to(out, "}}");
         return out;
     }
 };
+
+template <>
+struct std::formatter<termml::css::LayoutStyle> {
+    constexpr auto parse(auto& ctx) {
+        auto it = ctx.begin();
+        while (it != ctx.end()) {
+            if (*it == '}') break;
+            ++it;
+        }
+        return it;
+    }
+
+    auto format(termml::css::LayoutStyle const& v, auto& ctx) const {
+        auto out = ctx.out();
+
+        std::format_to(out, "LayoutStyle{{");
+        std::format_to(out, "min-width: {}, max-width: {}, width: {}, ", v.min_width, v.max_width, v.width);
+        std::format_to(out, "min-height: {}, max-height: {}, height: {}, ", v.min_height, v.max_height, v.height);
+        std::format_to(out, "display: {}, ", v.display);
+        std::format_to(out, "border-width: ({}, {}, {}, {}), ", v.border_top_width, v.border_right_width, v.border_bottom_width, v.border_left_width);
+        std::format_to(out, "padding: ({}), ", v.padding);
+        std::format_to(out, "white-space: {}, ", v.whitespace);
+        std::format_to(out, "overflow: (x: {}, y: {})", v.overflow_x, v.overflow_y);
+        std::format_to(out, "}}");
+        return out;
+    }
+};
+
+template <>
+struct std::formatter<termml::css::PaintStyle> {
+    constexpr auto parse(auto& ctx) {
+        auto it = ctx.begin();
+        while (it != ctx.end()) {
+            if (*it == '}') break;
+            ++it;
+        }
+        return it;
+    }
+
+    auto format(termml::css::PaintStyle const& v, auto& ctx) const {
+        auto out = ctx.out();
+
+        std::format_to(out, "PaintStyle{{");
+        std::format_to(out, "border-top: {}, ", v.border_top);
+        std::format_to(out, "border-right: {}, ", v.border_right);
+        std::format_to(out, "border-bottom: {}, ", v.border_bottom);
+        std::format_to(out, "border-left: {}, ", v.border_left);
+
+        auto [tl, tr, br, bl] = v.border_type;
+        std::format_to(out, "border_type: ({}, {}, {}, {}), ", tl, tr, br, bl);
+
+        std::format_to(out, "z-index: {}, ", v.z_index);
+        std::format_to(out, "color: {}, bg-color: {}", v.fg_color, v.bg_color);
+        std::format_to(out, "}}");
+        return out;
+    }
+};
 #endif // AMT_TERMML_CSS_STYLE_HPP
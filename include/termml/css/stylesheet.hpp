@@ -0,0 +1,270 @@
+#ifndef AMT_TERMML_CSS_STYLESHEET_HPP
+#define AMT_TERMML_CSS_STYLESHEET_HPP
+
+#include "../core/string_utils.hpp"
+#include "selector.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace termml::css {
+
+    struct Declaration {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    struct Rule {
+        // One selector of the rule's selector list, stored left to right.
+        std::vector<CompoundSelector> selector{};
+        // (ids, classes and attributes, tags) packed so that larger wins.
+        std::uint32_t specificity{};
+        // Source order; later rules win ties.
+        std::uint32_t order{};
+        std::uint32_t declaration_begin{};
+        std::uint32_t declaration_count{};
+        // Tags, ids and classes every match must have among its ancestors; 0 ends the list.
+        std::array<std::uint32_t, 4> ancestor_hashes{};
+    };
+
+    // Counting bloom filter over the tags, ids and classes of the element being styled
+    // and its ancestors, so rules with descendant or child combinators are rejected
+    // without walking up the tree.
+    struct AncestorFilter {
+        static constexpr std::size_t size = 1 << 12;
+        static constexpr std::uint32_t mask = size - 1;
+
+        static constexpr auto hash(char kind, std::string_view name) noexcept -> std::uint32_t {
+            auto h = 2166136261u;
+            h = (h ^ static_cast<std::uint8_t>(kind)) * 16777619u;
+            for (auto c: name) h = (h ^ static_cast<std::uint8_t>(c)) * 16777619u;
+            // 0 terminates `Rule::ancestor_hashes`.
+            return h | 1;
+        }
+
+        constexpr auto add(std::uint32_t h) noexcept -> void {
+            increment(h & mask);
+            increment((h >> 12) & mask);
+        }
+
+        constexpr auto remove(std::uint32_t h) noexcept -> void {
+            decrement(h & mask);
+            decrement((h >> 12) & mask);
+        }
+
+        constexpr auto may_contain(std::uint32_t h) const noexcept -> bool {
+            return m_counts[h & mask] && m_counts[(h >> 12) & mask];
+        }
+
+        constexpr auto may_match(Rule const& rule) const noexcept -> bool {
+            for (auto h: rule.ancestor_hashes) {
+                if (h == 0) break;
+                if (!may_contain(h)) return false;
+            }
+            return true;
+        }
+
+    private:
+        // Saturated counters stick, so the filter can only err towards "maybe".
+        constexpr auto increment(std::uint32_t i) noexcept -> void {
+            if (m_counts[i] != 0xff) ++m_counts[i];
+        }
+
+        constexpr auto decrement(std::uint32_t i) noexcept -> void {
+            if (m_counts[i] != 0xff) --m_counts[i];
+        }
+
+    private:
+        std::array<std::uint8_t, size> m_counts{};
+    };
+
+    // Rules from `<style>` blocks. Supports the selectors of `Selector` followed
+    // by a `{ key: value; ... }` block whose keys are the attribute names elements use
+    // inline; at-rules are skipped. Rules are bucketed by the id, class or tag of their
+    // rightmost compound, so an element is only matched against rules that can apply
+    // to it. The stylesheet keeps views into its sources.
+    struct Stylesheet {
+        std::vector<Rule> rules{};
+        std::vector<Declaration> declarations{};
+
+        constexpr auto empty() const noexcept -> bool {
+            return rules.empty();
+        }
+
+        // Whether some rule looks at ancestors, so restyling an element can change which
+        // rules match its descendants.
+        constexpr auto has_combinators() const noexcept -> bool {
+            return m_has_combinators;
+        }
+
+        auto declarations_of(Rule const& rule) const noexcept -> std::span<Declaration const> {
+            return std::span(declarations).subspan(rule.declaration_begin, rule.declaration_count);
+        }
+
+        // Parses `source` and adds its rules after the existing ones. Malformed rules are
+        // dropped.
+        auto append(std::string_view source) -> void {
+            auto i = std::size_t{};
+            while (true) {
+                skip_space_and_comments(source, i);
+                if (i >= source.size()) break;
+
+                if (source[i] == '@') {
+                    skip_at_rule(source, i);
+                    continue;
+                }
+
+                auto open = find_outside_comments(source, '{', i);
+                if (open == std::string_view::npos) break;
+                auto close = find_outside_comments(source, '}', open + 1);
+                if (close == std::string_view::npos) close = source.size();
+
+                auto selector = Selector::parse(core::utils::trim(source.substr(i, open - i)));
+                auto body = source.substr(open + 1, close - open - 1);
+                i = close + 1;
+                if (selector.empty()) continue;
+
+                auto begin = static_cast<std::uint32_t>(declarations.size());
+                parse_declarations(body);
+                auto count = static_cast<std::uint32_t>(declarations.size()) - begin;
+                if (count == 0) continue;
+
+                for (auto& complex: selector.alternatives) {
+                    add_rule(std::move(complex), begin, count);
+                }
+            }
+        }
+
+        // Calls `fn` with the index of every rule whose rightmost compound could match an
+        // element with this tag, id and class list. Each rule is reported at most once
+        // unless the class list repeats a class.
+        template <typename F>
+        auto for_each_candidate(std::string_view tag, std::string_view id, std::string_view classes, F&& fn) const -> void {
+            for (auto r: m_universal_rules) fn(r);
+            visit(m_tag_rules, tag, fn);
+            if (!id.empty()) visit(m_id_rules, id, fn);
+            if (!classes.empty() && !m_class_rules.empty()) {
+                for_each_word(classes, [this, &fn](std::string_view c) { visit(m_class_rules, c, fn); });
+            }
+        }
+
+    private:
+        using bucket_t = std::unordered_map<std::string_view, std::vector<std::uint32_t>>;
+
+        template <typename F>
+        static auto visit(bucket_t const& bucket, std::string_view key, F& fn) -> void {
+            if (auto it = bucket.find(key); it != bucket.end()) {
+                for (auto r: it->second) fn(r);
+            }
+        }
+
+        static constexpr auto skip_space_and_comments(std::string_view s, std::size_t& i) noexcept -> void {
+            while (i < s.size()) {
+                if (core::utils::is_space(s[i])) {
+                    ++i;
+                } else if (s.substr(i).starts_with("/*")) {
+                    auto end = s.find("*/", i + 2);
+                    i = end == std::string_view::npos ? s.size() : end + 2;
+                } else {
+                    break;
+                }
+            }
+        }
+
+        static constexpr auto find_outside_comments(std::string_view s, char c, std::size_t i) noexcept -> std::size_t {
+            for (; i < s.size(); ++i) {
+                if (s[i] == c) return i;
+                if (s.substr(i).starts_with("/*")) {
+                    auto end = s.find("*/", i + 2);
+                    if (end == std::string_view::npos) return std::string_view::npos;
+                    i = end + 1;
+                }
+            }
+            return std::string_view::npos;
+        }
+
+        // Skips a statement at-rule up to ';' or a block at-rule up to its matching '}'.
+        static constexpr auto skip_at_rule(std::string_view s, std::size_t& i) noexcept -> void {
+            auto depth = 0;
+            for (; i < s.size(); ++i) {
+                auto c = s[i];
+                if (c == ';' && depth == 0) break;
+                if (c == '{') ++depth;
+                if (c == '}' && --depth <= 0) break;
+            }
+            ++i;
+        }
+
+        auto parse_declarations(std::string_view body) -> void {
+            auto i = std::size_t{};
+            while (i < body.size()) {
+                skip_space_and_comments(body, i);
+                if (i >= body.size()) break;
+                auto end = find_outside_comments(body, ';', i);
+                if (end == std::string_view::npos) end = body.size();
+                auto decl = body.substr(i, end - i);
+                i = end + 1;
+
+                auto colon = decl.find(':');
+                if (colon == std::string_view::npos) continue;
+                auto key = core::utils::trim(decl.substr(0, colon));
+                auto value = decl.substr(colon + 1);
+                value = core::utils::trim(value.substr(0, value.find("/*")));
+                if (key.empty()) continue;
+                declarations.push_back({ .key = key, .value = value });
+            }
+        }
+
+        auto add_rule(std::vector<CompoundSelector>&& selector, std::uint32_t begin, std::uint32_t count) -> void {
+            auto index = static_cast<std::uint32_t>(rules.size());
+            auto rule = Rule {
+                .selector = std::move(selector),
+                .order = index,
+                .declaration_begin = begin,
+                .declaration_count = count
+            };
+
+            auto ids = 0u, classes = 0u, tags = 0u;
+            for (auto const& c: rule.selector) {
+                ids += !c.id.empty();
+                classes += static_cast<unsigned>(c.classes.size() + c.attributes.size());
+                tags += !c.is_universal();
+            }
+            rule.specificity = (std::min(ids, 0x3ffu) << 20) | (std::min(classes, 0x3ffu) << 10) | std::min(tags, 0x3ffu);
+
+            // Ids are the most selective, tags the least.
+            auto k = 0ul;
+            auto add_hash = [&rule, &k](char kind, std::string_view name) {
+                if (k < rule.ancestor_hashes.size()) rule.ancestor_hashes[k++] = AncestorFilter::hash(kind, name);
+            };
+            auto ancestors = std::span(rule.selector).first(rule.selector.size() - 1);
+            for (auto const& c: ancestors) if (!c.id.empty()) add_hash('#', c.id);
+            for (auto const& c: ancestors) for (auto cls: c.classes) add_hash('.', cls);
+            for (auto const& c: ancestors) if (!c.is_universal()) add_hash('<', c.tag);
+
+            m_has_combinators |= rule.selector.size() > 1;
+
+            auto const& key = rule.selector.back();
+            if (!key.id.empty()) m_id_rules[key.id].push_back(index);
+            else if (!key.classes.empty()) m_class_rules[key.classes.front()].push_back(index);
+            else if (!key.is_universal()) m_tag_rules[key.tag].push_back(index);
+            else m_universal_rules.push_back(index);
+
+            rules.push_back(std::move(rule));
+        }
+
+    private:
+        bucket_t m_id_rules{};
+        bucket_t m_class_rules{};
+        bucket_t m_tag_rules{};
+        std::vector<std::uint32_t> m_universal_rules{};
+        bool m_has_combinators{false};
+    };
+
+} // namespace termml::css
+
+#endif // AMT_TERMML_CSS_STYLESHEET_HPP
@@ -7,42 +7,194 @@
 #include "../core/terminal.hpp"
 #include "../core/device.hpp"
 #include "../core/string_utils.hpp"
+#include "../core/thread_pool.hpp"
 #include "../css/utils.hpp"
 #include "text.hpp"
 #include "line_box.hpp"
+#include "virtual_list.hpp"
 #include "../xml/node.hpp"
 #include <__ostream/print.h>
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <limits>
+#include <memory>
+#include <span>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace termml::layout {
     using node_index_t = std::size_t;
 
+    struct HeightResult {
+        int height{};
+        core::BoundingBox content{};
+        core::Point start_position{};
+        std::size_t previous_line{};
+
+        constexpr auto operator==(HeightResult const&) const noexcept -> bool = default;
+    };
+
+    // What a node's parent passed it in each pass of the last layout and what came back.
+    // A clean node whose inputs are unchanged keeps its subtree as it is.
+    struct LayoutInputs {
+        // Resolve pass: the parent's size.
+        css::Number parent_width{css::Number::fit()};
+        css::Number parent_height{css::Number::fit()};
+        // Width pass: the parent's available width, the width a node that fits its content
+        // may take up, the node's width unit before the pass and the width it took up.
+        int max_parent_width{};
+        int width_arg{};
+        css::Unit width_unit{};
+        int width{};
+        // Whether the width pass reached the node; children of percentage-wide nodes are
+        // never sized.
+        bool sized{false};
+        // Height pass: the container width after the width pass, where the node was placed
+        // and where its content ended, and the lines it laid out.
+        int container_width{};
+        HeightResult position{};
+        HeightResult result{};
+        std::size_t line_begin{};
+        std::size_t line_end{};
+    };
+
+    // Where a height pass writes its lines and what it noted about them.
+    struct LinePass {
+        std::vector<LineBox>* lines{};
+        // Lines laid out so far; `lines` can hold more while the last layout's lines are
+        // overwritten in place.
+        std::size_t count{};
+        bool in_place{false};
+        // Whether the line before the cursor was laid out or moved in this pass.
+        bool last_line_laid_out{false};
+        // Whether a line or container moved after it was placed.
+        bool moved_lines{false};
+        std::vector<LineBox> old_lines{};
+        std::size_t old_lines_offset{};
+        std::vector<LineBox> scratch_lines{};
+        LineCache* cache{};
+
+        // Set for a subtree laid out on its own (see `SubtreeTask`). The lines before it
+        // are not in `lines`, which start with two stand-ins: line 1 for the line before
+        // the subtree and line 0 for a previous line of 0 passed down to it.
+        bool detached{false};
+        // Previous lines the subtree was passed that texts in it could not check, and
+        // the cursor at the time.
+        std::vector<std::pair<std::size_t, std::size_t>> outside_checks{};
+        // Whether a text continued the stand-in for the line before the subtree.
+        bool continues_line_before{false};
+
+        // The previous line of a subtree laid out on its own.
+        static constexpr auto outside_line = std::numeric_limits<std::size_t>::max() - 1;
+    };
+
+    struct ParallelLayoutOptions {
+        // 0 uses every hardware thread; 1 lays out on the calling thread only.
+        std::size_t threads{1};
+        // Block children with fewer nodes than this are laid out where they are placed.
+        std::size_t min_subtree_nodes{1024};
+    };
+
+    // A block child laid out on another thread before its parent gets to it: at the top
+    // of a layout of its own, into lines of its own. Nothing in a block depends on the
+    // blocks above it but where it starts, so the parent moves the result down into place
+    // once it knows, or lays the child out again if it was not placed as expected.
+    struct SubtreeTask {
+        // Index among the parent's children.
+        std::size_t child{};
+        node_index_t node{};
+        core::BoundingBox container{};
+        HeightResult position{};
+        HeightResult result{};
+        std::vector<LineBox> lines{};
+        LinePass pass{};
+        bool merged{false};
+
+        // Where the subtree ended up: the line count before it, how far down it moved and
+        // the previous line it was passed.
+        std::size_t base{};
+        int dy{};
+        std::size_t previous_line{};
+
+        // The line index or count `i` of the subtree's own layout in the parent's.
+        constexpr auto line(std::size_t i) const noexcept -> std::size_t {
+            if (i == LinePass::outside_line) return previous_line;
+            if (i == 0) return 0;
+            return std::max<std::size_t>(base + i, 2) - 2;
+        }
+
+        constexpr auto translate(HeightResult r) const noexcept -> HeightResult {
+            r.content.y += dy;
+            r.start_position.y += dy;
+            r.previous_line = line(r.previous_line);
+            return r;
+        }
+    };
+
+    // A node's children: a range of `LayoutContext::children`.
+    struct ChildSpan {
+        unsigned start{};
+        unsigned size{};
+
+        constexpr auto empty() const noexcept -> bool { return size == 0; }
+    };
+
+    // What a scroll container is drawn into. It is kept across renders until the node is
+    // laid out again.
+    struct Canvas {
+        core::Terminal terminal{};
+        bool dirty{true};
+    };
+
     struct LayoutNode {
         std::string_view tag{};
+        xml::NodeKind kind{xml::NodeKind::Element};
+        xml::TagId tag_id{xml::TagId::Unknown};
+        // Index into the document's element or text pool, depending on `kind`.
         node_index_t node_index{std::numeric_limits<node_index_t>::max()};
         std::size_t style_index{std::numeric_limits<node_index_t>::max()};
         std::string_view text{};
+        BreakIndex breaks{};
         LineSpan lines{};
-        std::vector<node_index_t> children{};
+        ChildSpan children{};
+        node_index_t parent{std::numeric_limits<node_index_t>::max()};
         core::BoundingBox container{};
 
+        // A scroll container gets a canvas the first time it is drawn; see `Canvas`.
         bool scrollable_x{false};
         bool scrollable_y{false};
 
-        core::Terminal canvas{};
+        LayoutInputs last{};
+        // Runs every pass in the next layout: the node is new, changed, has a changed
+        // descendant or was given different inputs.
+        bool dirty{true};
+
+        constexpr auto is_text() const noexcept -> bool { return kind == xml::NodeKind::TextContent; }
     };
 
     struct LayoutContext {
         core::BoundingBox viewport;
         std::vector<LayoutNode> nodes;
         std::vector<LineBox> lines;
-
-        constexpr LayoutContext(core::BoundingBox vp) noexcept
+        // The children of every node, side by side; `LayoutNode::children` is the range
+        // of one node. A node given other children gets a new range at the end, and the
+        // array is compacted once it is mostly old ranges.
+        std::vector<node_index_t> children;
+        // Used values: the layout part of the document's computed style for every layout
+        // node, which layout resolves percentages and auto sizes into. Computed styles are
+        // shared between elements, used values are not. The paint part is only read when
+        // rendering, so the sizing passes never touch it. Both are indexed by
+        // `LayoutNode::style_index`.
+        std::vector<css::LayoutStyle> styles;
+        std::vector<css::PaintStyle> paint_styles;
+        // Large block children are laid out on several threads; see `SubtreeTask`.
+        ParallelLayoutOptions parallel{};
+
+        LayoutContext(core::BoundingBox vp) noexcept
             : viewport(vp)
         {}
 
@@ -52,28 +204,105 @@ namespace termml::layout {
         LayoutContext& operator=(LayoutContext &&) noexcept = default;
         ~LayoutContext() = default;
 
+        // Does nothing if neither the document nor the viewport changed since the last call.
+        // Otherwise the tree is kept and only what changed is laid out again: the changed
+        // nodes and their ancestors run every pass, and a clean child is skipped with its
+        // whole subtree when its parent passes it what it did last time, or moved down with
+        // its lines when only the children above it changed height. A different
+        // document, or a last layout that moved lines after placing them (collapsed
+        // margins, a text wrapping its predecessor), lays out everything.
         auto compute(xml::Context* context) -> void {
             context->resolve_css();
-            nodes.clear();
-            lines.clear();
-            auto layout = LayoutNode {
-                .tag = {},
-                .node_index = 0,
-                .style_index = 0
-            };
+            if (m_context == context && m_generation == context->generation && m_viewport == viewport && !nodes.empty() && m_scrolled.empty()) {
+                return;
+            }
+            auto const reuse = m_context == context && !nodes.empty() && !m_pass.moved_lines
+                && update_nodes(context, m_generation);
+            auto const resized = m_viewport != viewport;
+            m_context = context;
+            m_generation = context->generation;
+            m_viewport = viewport;
+
+            m_rebuilt = !reuse;
+            if (!reuse) {
+                initialize_nodes(context);
+                lines.clear();
+            } else {
+                // A scrolled list is laid out again, and so are its ancestors.
+                for (auto element: m_scrolled) {
+                    if (element >= m_element_nodes.size()) continue;
+                    for (auto n = m_element_nodes[element]; n != xml::invalid_index; n = nodes[n].parent) {
+                        nodes[n].dirty = true;
+                    }
+                }
+                // Children whose available size changed are laid out again; texts keep
+                // their break indices, so re-wrapping them does not decode them again.
+                if (resized) nodes[0].dirty = true;
+            }
+            m_scrolled.clear();
+            if (reuse && !nodes[0].dirty) return;
+
+            m_pass.lines = &lines;
+            m_pass.cache = &m_line_cache;
+            m_pass.moved_lines = false;
+            m_pass.in_place = reuse;
+            m_pass.count = 0;
+            m_pass.last_line_laid_out = false;
 
-            nodes.push_back(std::move(layout));
-            initialize_nodes(context, { .index = 0, .kind = xml::NodeKind::Element }, 0);
             resolve_style(context);
             resolve_cyclic_width(context, 0, viewport.width);
-            resolve_cyclic_height(context, 0, {
+            resolve_cyclic_height(context, m_pass, 0, {
                 .height = viewport.height,
                 .content = viewport,
                 .start_position = { viewport.min_x(), viewport.min_y() }
             });
+            // Lines of removed texts can be left at the end.
+            lines.resize(m_pass.count);
+            m_pass.old_lines.clear();
             // compute_layout(context, viewport);
         }
 
+        // Colors for `palette(...)` references. Switching themes only needs a repaint:
+        // nothing is restyled or laid out again.
+        auto set_palette(css::Palette const& palette) -> void {
+            m_palette = palette;
+            for (auto& [_, canvas]: m_canvases) canvas.dirty = true;
+        }
+
+        constexpr auto palette() const noexcept -> css::Palette const& {
+            return m_palette;
+        }
+
+        // Scrolls the virtual list `element`, a document element with `virtual-rows`, so
+        // that `offset` cells of its rows are above its content box. Only the list is laid
+        // out again in the next `compute`, which clamps the offset to its rows.
+        auto scroll_to(node_index_t element, int offset) -> void {
+            m_virtual_lists[element].scroll = std::max(offset, 0);
+            m_scrolled.push_back(element);
+        }
+
+        auto scroll_by(node_index_t element, int delta) -> void {
+            scroll_to(element, scroll_offset(element) + delta);
+        }
+
+        auto scroll_offset(node_index_t element) const -> int {
+            auto it = m_virtual_lists.find(element);
+            return it == m_virtual_lists.end() ? 0 : it->second.scroll;
+        }
+
+        // Layout nodes of the rows of the virtual list `element` that the last `compute`
+        // laid out, top to bottom.
+        auto visible_rows(node_index_t element) const -> std::span<node_index_t const> {
+            auto it = m_virtual_lists.find(element);
+            if (it == m_virtual_lists.end()) return {};
+            return it->second.laid_out;
+        }
+
+        constexpr auto children_of(node_index_t node) const noexcept -> std::span<node_index_t const> {
+            auto const span = nodes[node].children;
+            return std::span(children).subspan(span.start, span.size);
+        }
+
         template <core::detail::IsScreen S>
         auto render(core::Device<S>& dev, xml::Context const* context, node_index_t node = 0) -> void {
             render_node(dev, context, node, viewport);
@@ -83,64 +312,311 @@ namespace termml::layout {
             auto tab = level * 4;
             auto const& l = nodes[index];
             std::println("{:{}} > {}", ' ', tab, l.tag);
-            if(l.tag.empty() && index != 0) {
+            if (l.is_text()) {
                 std::println("{:{}}   |- Text: '{}'", ' ', tab, l.text);
             }
 
             std::println("{:{}}   |- Container: {}", ' ', tab, l.container);
             std::println("{:{}}   |- Lines: {}", ' ', tab, std::span(lines.data() + l.lines.start, l.lines.size));
-            std::println("{:{}}   |- Style: [{}]", ' ', tab, context->styles[l.style_index]);
+            std::println("{:{}}   |- Style: [{}]", ' ', tab, styles[l.style_index]);
+            std::println("{:{}}   |- Paint: [{}]", ' ', tab, paint_styles[l.style_index]);
 
-            for (auto n: l.children) {
+            auto const rows = styles[l.style_index].is_virtual_list()
+                ? visible_rows(l.node_index)
+                : children_of(index);
+            for (auto n: rows) {
                 dump(context, n, level + 1);
             }
         }
     private:
-        auto initialize_nodes(xml::Context const* context, xml::Node const& node, node_index_t layout_node_index) -> node_index_t /*inserted layout_index*/ {
-            if (node.kind == xml::NodeKind::TextContent) {
-                std::unreachable();
-            }
+        auto push_style(css::Style const& style) -> void {
+            // Used values are reset from the computed style before every layout of the node.
+            styles.emplace_back();
+            paint_styles.push_back(css::PaintStyle::from(style));
+        }
+
+        auto computed_style(xml::Context const* context, LayoutNode const& node) const noexcept -> css::Style const& {
+            auto index = node.is_text()
+                ? context->text_nodes[node.node_index].style_index
+                : context->element_nodes[node.node_index].style_index;
+            return context->styles[index];
+        }
 
-            auto const& el = context->element_nodes[node.index];
+        auto initialize_nodes(xml::Context const* context) -> void {
+            styles.clear();
+            paint_styles.clear();
+            nodes.clear();
+            children.clear();
+            m_canvases.clear();
+            m_dead_children = 0;
+            // Every node gets at most one entry in each array.
+            auto const capacity = context->element_nodes.size() + context->text_nodes.size();
+            nodes.reserve(capacity);
+            children.reserve(capacity);
+            styles.reserve(capacity);
+            paint_styles.reserve(capacity);
+            m_element_nodes.assign(context->element_nodes.size(), xml::invalid_index);
+            for (auto& [_, list]: m_virtual_lists) list.detach();
+
+            add_node(context, xml::Context::root, xml::invalid_index);
+            nodes[0].tag = {};
+            nodes[0].tag_id = xml::TagId::Root;
+            add_children(context, xml::Context::root.index, 0);
+        }
 
-            auto current_node_index = layout_node_index;
-            if (node.index != 0) {
-                auto next_index = nodes.size();
+        auto add_node(xml::Context const* context, xml::Node n, node_index_t parent) -> node_index_t {
+            auto const index = nodes.size();
+            if (n.kind == xml::NodeKind::TextContent) {
+                auto const& text = context->text_nodes[n.index];
+                push_style(context->styles[text.style_index]);
+                nodes.push_back(make_text_node(context, n, parent, index, BreakIndex::build(text.normalized_text)));
+            } else {
+                auto const& el = context->element_nodes[n.index];
+                push_style(context->styles[el.style_index]);
                 nodes.push_back({
                     .tag = el.tag,
-                    .node_index = node.index,
-                    .style_index = el.style_index
+                    .tag_id = el.tag_id,
+                    .node_index = n.index,
+                    .style_index = index,
+                    .parent = parent
                 });
-                nodes[layout_node_index].children.push_back(next_index);
-                current_node_index = next_index;
+                m_element_nodes[n.index] = index;
+            }
+            return index;
+        }
+
+        static auto make_text_node(
+            xml::Context const* context,
+            xml::Node n,
+            node_index_t parent,
+            node_index_t index,
+            BreakIndex&& breaks
+        ) -> LayoutNode {
+            return {
+                .tag = {},
+                .kind = xml::NodeKind::TextContent,
+                .node_index = n.index,
+                .style_index = index,
+                .text = context->text_nodes[n.index].normalized_text,
+                .breaks = std::move(breaks),
+                .parent = parent
+            };
+        }
+
+        // Starts the layout node `index`, which held the text node `n`, over as if it was
+        // added for it now. A changed text's break index is rebuilt in the storage it had.
+        auto renew_text_node(xml::Context const* context, xml::Node n, node_index_t index) -> void {
+            auto const& text = context->text_nodes[n.index];
+            auto const old = nodes[index].text;
+            auto breaks = std::move(nodes[index].breaks);
+            if (old.data() != text.normalized_text.data() || old.size() != text.normalized_text.size()) {
+                breaks.assign(text.normalized_text);
+            }
+            nodes[index] = make_text_node(context, n, nodes[index].parent, index, std::move(breaks));
+            styles[index] = {};
+            paint_styles[index] = css::PaintStyle::from(context->styles[text.style_index]);
+        }
+
+        // Whether the document node `n` gets a layout node; empty texts do not.
+        static constexpr auto has_layout_node(xml::Context const* context, xml::Node n) noexcept -> bool {
+            if (n.kind == xml::NodeKind::TextContent) return !context->text_nodes[n.index].normalized_text.empty();
+            return n.kind == xml::NodeKind::Element;
+        }
+
+        // Adds layout nodes for the subtree below `element` under the layout node `parent`.
+        // Nodes are numbered in pre-order; a node's children range is filled in as they are.
+        auto add_children(xml::Context const* context, node_index_t element, node_index_t parent) -> void {
+            struct Pending {
+                xml::Node node;
+                node_index_t parent;
+                // Entry of `children` the node goes into.
+                std::size_t slot;
+            };
+            auto stack = std::vector<Pending>{};
+            auto push_children = [this, &stack, context](node_index_t index, node_index_t parent) {
+                auto const& el = context->element_nodes[index];
+                auto const start = children.size();
+                for (auto ch: el.childern) {
+                    if (has_layout_node(context, ch)) children.push_back(xml::invalid_index);
+                }
+                nodes[parent].children = {
+                    .start = static_cast<unsigned>(start),
+                    .size = static_cast<unsigned>(children.size() - start)
+                };
+                auto slot = children.size();
+                for (auto it = el.childern.rbegin(); it != el.childern.rend(); ++it) {
+                    if (has_layout_node(context, *it)) stack.push_back({ *it, parent, --slot });
+                }
+            };
+
+            push_children(element, parent);
+            while (!stack.empty()) {
+                auto [ch, parent, slot] = stack.back();
+                stack.pop_back();
+
+                auto index = add_node(context, ch, parent);
+                children[slot] = index;
+                if (ch.kind == xml::NodeKind::Element) push_children(ch.index, index);
+            }
+        }
+
+        // Brings the kept tree in line with the document. Whitespace collapsing goes
+        // through every element that changed since `since` and their ancestors, so only
+        // those get their children again; elements and unchanged texts keep their layout
+        // nodes. Returns false once dropped nodes make up half the tree.
+        auto update_nodes(xml::Context const* context, xml::generation_t since) -> bool {
+            if (nodes.size() > 2 * (context->element_nodes.size() + context->text_nodes.size())) return false;
+            m_element_nodes.resize(context->element_nodes.size(), xml::invalid_index);
+            update_children(context, 0, since);
+            if (m_dead_children > children.size() / 2) compact_children();
+            return true;
+        }
+
+        // Packs the children ranges of all nodes, including ones out of the tree that can
+        // come back, next to each other.
+        auto compact_children() -> void {
+            auto packed = std::vector<node_index_t>{};
+            packed.reserve(children.size() - m_dead_children);
+            for (auto& n: nodes) {
+                auto const first = children.begin() + n.children.start;
+                n.children.start = static_cast<unsigned>(packed.size());
+                packed.insert(packed.end(), first, first + n.children.size);
             }
+            children = std::move(packed);
+            m_dead_children = 0;
+        }
 
-            for (auto i = 0ul; i < el.childern.size(); ++i) {
-                auto const& ch = el.childern[i];
-                auto next_index = nodes.size();
+        // Returns whether `node` has to be laid out again.
+        auto update_children(xml::Context const* context, node_index_t node, xml::generation_t since) -> bool {
+            auto const& el = context->element_nodes[nodes[node].node_index];
+            auto dirty = el.restyled > since;
+            if (dirty) paint_styles[nodes[node].style_index] = css::PaintStyle::from(context->styles[el.style_index]);
+
+            // The new children are gathered on top of the scratch stack, since nested calls
+            // gather theirs there too. `children` can grow meanwhile, so the old ones are
+            // read by index.
+            auto const old = nodes[node].children;
+            auto old_child = [this, old](std::size_t i) { return children[old.start + i]; };
+            auto const mark = m_child_scratch.size();
+            auto next_text = std::size_t{};
+            for (auto ch: el.childern) {
                 if (ch.kind == xml::NodeKind::TextContent) {
-                    auto txt = context->text_nodes[ch.index].normalized_text;
-                    if (txt.empty()) continue;
-
-                    nodes.push_back({
-                        .tag = {},
-                        .node_index = std::numeric_limits<std::size_t>::max(),
-                        .style_index = context->text_nodes[ch.index].style_index,
-                        .text = txt
-                    });
-                    nodes[current_node_index].children.push_back(next_index);
+                    auto text = context->text_nodes[ch.index].normalized_text;
+                    if (text.empty()) continue;
+                    // Texts are matched in order; a restyled element's texts are restyled too.
+                    while (next_text < old.size && !nodes[old_child(next_text)].is_text()) ++next_text;
+                    if (next_text < old.size) {
+                        auto const index = old_child(next_text++);
+                        auto const& t = nodes[index];
+                        if (t.node_index == ch.index) {
+                            // A changed or restyled text keeps its node.
+                            if (dirty || t.text.data() != text.data() || t.text.size() != text.size()) {
+                                renew_text_node(context, ch, index);
+                                dirty = true;
+                            }
+                            m_child_scratch.push_back(index);
+                            continue;
+                        }
+                    }
+                    m_child_scratch.push_back(add_node(context, ch, node));
+                    dirty = true;
                 } else if (ch.kind == xml::NodeKind::Element) {
-                    initialize_nodes(context, ch, current_node_index);
+                    auto l = m_element_nodes[ch.index];
+                    if (l == xml::invalid_index) {
+                        l = add_node(context, ch, node);
+                        add_children(context, ch.index, l);
+                    } else {
+                        if (context->element_nodes[ch.index].collapsed > since) update_children(context, l, since);
+                        // Its lines are from a layout it was not part of, or from another place.
+                        if (nodes[l].parent != node) mark_dirty(l);
+                    }
+                    m_child_scratch.push_back(l);
+                    dirty |= nodes[l].dirty;
+                }
+            }
+
+            auto const fresh = std::span(m_child_scratch).subspan(mark);
+            auto const changed = !std::ranges::equal(fresh, children_of(node));
+            dirty |= changed;
+            if (!m_virtual_lists.empty()) {
+                if (auto it = m_virtual_lists.find(nodes[node].node_index); it != m_virtual_lists.end()) {
+                    it->second.stale |= changed;
+                    // It may have become a list or stopped being one.
+                    if (el.restyled > since) it->second.attached = false;
                 }
             }
-            return current_node_index;
+            for (auto o: children_of(node)) {
+                if (nodes[o].parent == node) nodes[o].parent = xml::invalid_index;
+            }
+            for (auto c: fresh) nodes[c].parent = node;
+            if (changed) {
+                // Fewer children fit in the old range; more get a new one.
+                auto& span = nodes[node].children;
+                if (fresh.size() > span.size) {
+                    m_dead_children += span.size;
+                    span.start = static_cast<unsigned>(children.size());
+                    children.insert(children.end(), fresh.begin(), fresh.end());
+                } else {
+                    m_dead_children += span.size - fresh.size();
+                    std::ranges::copy(fresh, children.begin() + span.start);
+                }
+                span.size = static_cast<unsigned>(fresh.size());
+            }
+            m_child_scratch.resize(mark);
+            nodes[node].dirty = dirty;
+            return dirty;
+        }
+
+        auto mark_dirty(node_index_t node) -> void {
+            auto& stack = m_walk;
+            stack.assign(1, node);
+            while (!stack.empty()) {
+                auto n = stack.back();
+                stack.pop_back();
+                nodes[n].dirty = true;
+                auto const kids = children_of(n);
+                stack.insert(stack.end(), kids.begin(), kids.end());
+            }
         }
 
-        auto resolve_style(xml::Context* context, node_index_t node = 0) -> void {
-            auto& layout = nodes[node];
-            auto& style = context->styles[layout.style_index];
+        // Marks a subtree left out of the layout, whose lines are gone.
+        auto drop_lines(node_index_t node) -> void {
+            auto& stack = m_walk;
+            stack.assign(1, node);
+            while (!stack.empty()) {
+                auto n = stack.back();
+                stack.pop_back();
+                nodes[n].dirty = true;
+                nodes[n].lines = {};
+                auto const kids = children_of(n);
+                stack.insert(stack.end(), kids.begin(), kids.end());
+            }
+        }
 
-            if (node == 0) {
+        // Starts a dirty node over from its computed style.
+        auto reset_node(xml::Context const* context, node_index_t node) -> void {
+            auto& n = nodes[node];
+            styles[n.style_index] = css::LayoutStyle::from(computed_style(context, n));
+            // Rows of a virtual list stack as blocks.
+            if (n.parent != xml::invalid_index && styles[nodes[n.parent].style_index].is_virtual_list()) {
+                styles[n.style_index].display = css::Display::Block;
+            }
+            n.container = {};
+            n.last.sized = false;
+            if (!m_canvases.empty()) {
+                if (auto it = m_canvases.find(node); it != m_canvases.end()) it->second.dirty = true;
+            }
+        }
+
+        static constexpr auto same_size(css::Number a, css::Number b) noexcept -> bool {
+            if (a.unit != b.unit) return false;
+            return a.is_precentage() ? a.f == b.f : a.i == b.i;
+        }
+
+        auto resolve_style(xml::Context const* context) -> void {
+            reset_node(context, 0);
+            {
+                auto& style = styles[nodes[0].style_index];
                 style.width = css::Number {
                     .i = static_cast<int>(viewport.width),
                     .unit = css::Unit::Cell
@@ -158,27 +634,74 @@ namespace termml::layout {
                     .left = css::Number::from_cell(static_cast<int>(viewport.min_x())),
                 };
             }
+            resolve_subtree_style(context, 0);
+        }
 
-            for (auto l: layout.children) {
-                auto& ts = context->styles[nodes[l].style_index];
-                if (style.width.is_absolute()) {
-                    resolve_style_width_releated_props(ts, style.width.i);
-                }
-                ts.margin = ts.margin.resolve(style.width.i);
-                resolve_style(context, l);
+        // What a parent resolves in each child before sizing it.
+        static constexpr auto resolve_child_style(
+            css::LayoutStyle& style,
+            css::Number parent_width,
+            css::Number parent_height
+        ) noexcept -> void {
+            if (parent_width.is_absolute()) {
+                resolve_style_width_releated_props(style, parent_width.i);
             }
+            style.margin = style.margin.resolve(parent_width.i);
+            if (parent_height.is_absolute()) {
+                resolve_style_height_releated_props(style, parent_height.i);
+            }
+        }
 
-            for (auto l: layout.children) {
-                auto& ts = context->styles[nodes[l].style_index];
-                if (style.height.is_absolute()) {
-                    resolve_style_height_releated_props(ts, style.height.i);
+        auto resolve_subtree_style(xml::Context const* context, node_index_t root) -> void {
+            // Parents resolve before children, so a single pre-order pass sees the final
+            // parent size.
+            auto& stack = m_style_walk;
+            stack.assign(1, root);
+            while (!stack.empty()) {
+                auto node = stack.back();
+                stack.pop_back();
+
+                auto const& layout = nodes[node];
+                auto const width = styles[layout.style_index].width;
+                auto const height = styles[layout.style_index].height;
+                if (styles[layout.style_index].is_virtual_list()) {
+                    // Rows are resolved when they are laid out; see `prepare_row`.
+                    auto& list = m_virtual_lists[layout.node_index];
+                    list.parent_width = width;
+                    list.parent_height = height;
+                    continue;
+                }
+                auto const kids = children_of(node);
+                for (auto l: kids) {
+                    auto& ch = nodes[l];
+                    if (!ch.dirty) {
+                        if (same_size(ch.last.parent_width, width) && same_size(ch.last.parent_height, height)) continue;
+                        mark_dirty(l);
+                    }
+                    reset_node(context, l);
+                    resolve_child_style(styles[ch.style_index], width, height);
+                    ch.last.parent_width = width;
+                    ch.last.parent_height = height;
+                }
+
+                for (auto it = kids.rbegin(); it != kids.rend(); ++it) {
+                    if (nodes[*it].dirty) stack.push_back(*it);
                 }
-                resolve_style(context, l);
             }
         }
 
+        // Starts a clean child's subtree over from the parent size it was resolved against,
+        // once a later pass passes it something new.
+        auto restyle_child(xml::Context const* context, node_index_t node) -> void {
+            mark_dirty(node);
+            reset_node(context, node);
+            auto const& n = nodes[node];
+            resolve_child_style(styles[n.style_index], n.last.parent_width, n.last.parent_height);
+            resolve_subtree_style(context, node);
+        }
+
         static constexpr auto resolve_style_width_releated_props(
-            css::Style& style,
+            css::LayoutStyle& style,
             int parent_width,
             bool resolve_auto_fit = false
         ) noexcept -> void {
@@ -202,18 +725,42 @@ namespace termml::layout {
             style.inset = style.inset.resolve(parent_width);
         }
 
+        // What a parent does for each child in the width pass. A child that fits its content
+        // may take up `parent_width`. Returns the width the child takes up.
+        constexpr auto resolve_child_width(
+            xml::Context* context,
+            node_index_t node,
+            int max_parent_width,
+            int parent_width
+        ) noexcept -> int {
+            auto& cs = styles[nodes[node].style_index];
+            cs.margin = cs.margin.resolve(max_parent_width);
+            if (cs.width.is_absolute()) {
+                resolve_cyclic_width(context, node, cs.width.i);
+                return cs.width.i;
+            } else if (cs.width.is_fit()) {
+                return resolve_cyclic_width(context, node, parent_width);
+            } else if (cs.width.is_precentage()) {
+                resolve_style_width_releated_props(cs, max_parent_width, true);
+                return cs.width.i;
+            }
+            return 0;
+        }
+
         constexpr auto resolve_cyclic_width(
             xml::Context* context,
             node_index_t node,
             int max_parent_width
         ) noexcept -> int /*container width*/ {
             auto& el = nodes[node];
-            auto& style = context->styles[el.style_index];
+            auto& style = styles[el.style_index];
             auto content_width = 0;
+            el.last.sized = true;
 
-            if (el.tag.empty() && node != 0) {
+            if (el.is_text()) {
                 auto text = TextLayouter{
                     .text = el.text,
+                    .breaks = &el.breaks
                 };
                 content_width = text.measure_width();
                 if (style.whitespace != css::Whitespace::NoWrap) {
@@ -221,35 +768,48 @@ namespace termml::layout {
                 }
             }
 
+            if (style.is_virtual_list()) {
+                // Rows are sized when they are laid out; see `prepare_row`. Since they are
+                // not all measured, a list that fits its content takes up the width it has.
+                auto& list = m_virtual_lists[el.node_index];
+                list.max_parent_width = max_parent_width;
+                list.width_arg = style.width.is_absolute() ? style.width.i : max_parent_width;
+                el.container.width = style.width.is_absolute() ? style.width.i : max_parent_width;
+                if (!style.width.is_absolute()) resolve_style_width_releated_props(style, el.container.width, true);
+                return el.container.width;
+            }
+
             auto last_inline_element = false;
-            for (auto i = 0ul; i < el.children.size(); ++i) {
-                auto l = el.children[i];
-                auto const& c = nodes[l];
-                auto& cs = context->styles[c.style_index];
-                cs.margin = cs.margin.resolve(max_parent_width);
+            auto const kids = children_of(node);
+            for (auto i = 0ul; i < kids.size(); ++i) {
+                auto l = kids[i];
+                auto& c = nodes[l];
+                auto const& cs = styles[c.style_index];
                 auto is_inline = cs.is_inline_context();
-                auto margin = cs.margin.horizontal();
+                auto parent_width = style.width.is_absolute() ? style.width.i : max_parent_width;
+                if (is_inline == last_inline_element && is_inline == true) {
+                    parent_width += content_width;
+                }
 
-                if (cs.width.is_absolute()) {
-                    auto w = cs.width.i; 
-                    if (is_inline == last_inline_element && is_inline == true) {
-                        w += content_width;
+                if (!c.dirty) {
+                    auto fits = c.last.width_unit == css::Unit::Auto;
+                    if (c.last.max_parent_width != max_parent_width || (fits && c.last.width_arg != parent_width)) {
+                        restyle_child(context, l);
                     }
-                    content_width = std::max(content_width, w);
-                    resolve_cyclic_width(context, l, cs.width.i);
-                } else if (cs.width.is_fit()) {
-                    auto parent_width = style.width.is_absolute() ? style.width.i : max_parent_width;
-                    if (is_inline == last_inline_element && is_inline == true) {
-                        parent_width += content_width;
-                    }
-                    content_width = std::max(
-                        content_width,
-                        resolve_cyclic_width(context, l, parent_width)
-                    );
-                } else if (cs.width.is_precentage()) {
-                    resolve_style_width_releated_props(cs, max_parent_width, true);
-                    content_width = std::max(content_width, cs.width.i);
                 }
+                if (c.dirty) {
+                    c.last.max_parent_width = max_parent_width;
+                    c.last.width_arg = parent_width;
+                    c.last.width_unit = cs.width.unit;
+                    c.last.width = resolve_child_width(context, l, max_parent_width, parent_width);
+                }
+                auto margin = cs.margin.horizontal();
+
+                auto w = c.last.width;
+                if (c.last.width_unit == css::Unit::Cell && is_inline == last_inline_element && is_inline == true) {
+                    w += content_width;
+                }
+                content_width = std::max(content_width, w);
 
                 last_inline_element = is_inline;
                 content_width += margin;
@@ -261,11 +821,8 @@ namespace termml::layout {
             }
 
             auto& padding = style.padding;
-            auto& border_left = style.border_left;
-            auto& border_right = style.border_right;
-
-            content_width += border_left.border_width();
-            content_width += border_right.border_width();
+            content_width += style.border_left_width;
+            content_width += style.border_right_width;
 
             auto per = 0.f;
             if (padding.left.is_precentage()) per += padding.left.f / 100.f;
@@ -289,7 +846,7 @@ namespace termml::layout {
         }
 
         static constexpr auto resolve_style_height_releated_props(
-            css::Style& style,
+            css::LayoutStyle& style,
             int parent_height,
             bool resolve_auto_fit = false
         ) noexcept -> void {
@@ -313,7 +870,7 @@ namespace termml::layout {
             node_index_t node
         ) const noexcept -> std::pair<std::size_t /*size*/, bool /*whitespace found*/>{
             auto const& el = nodes[node];
-            auto const& s = context->styles[el.style_index];
+            auto const& s = styles[el.style_index];
             if (s.has_start_whitespace()) return { 0, true };
             if (!s.has_inline_flow()) return { 0, true };
 
@@ -322,14 +879,14 @@ namespace termml::layout {
                 true
             };
 
-            if (el.tag.empty()) {
-                auto pos = detail::find_word(el.text);
+            if (el.is_text()) {
+                auto pos = std::size_t{el.breaks.words.front().end};
                 if (pos >= el.text.size()) return { el.text.size(), false };
                 return { pos, true };
             }
 
             std::size_t res{};
-            for (auto l : el.children) {
+            for (auto l : children_of(node)) {
                 auto [sz, ws] = get_inline_sibling_word_size_helper(context, l);
                 res += sz;
                 if (ws) return { res, true };
@@ -343,10 +900,10 @@ namespace termml::layout {
             node_index_t parent,
             std::size_t child_index
         ) const noexcept -> std::size_t {
-            auto const& el = nodes[parent];
+            auto const size = nodes[parent].children.size;
             ++child_index;
             std::size_t res{};
-            for (; child_index < el.children.size(); ++child_index) {
+            for (; child_index < size; ++child_index) {
                 auto [sz, ws] = get_inline_sibling_word_size_helper(context, child_index);
                 res += sz;
                 if (ws) return res;
@@ -355,33 +912,386 @@ namespace termml::layout {
             return res;
         }
 
-        struct HeightResult {
-            int height{};
-            core::BoundingBox content{};
-            core::Point start_position{};
-            std::size_t previous_line{};
-        };
+        // Lays `t` out at the line cursor. The last layout's lines are overwritten in place
+        // until a text's lines no longer line up with its old ones; from there on they are
+        // appended, and the rest of the old lines are set aside for clean subtrees.
+        auto layout_text(LinePass& pass, TextLayouter& t, std::size_t previous_line, css::LayoutStyle const& style, LineSpan old) -> TextRenderResult {
+            auto& lines = *pass.lines;
+            auto const cursor = pass.count;
+            auto const continues = cursor == previous_line + 1;
+            if (pass.detached) {
+                if (previous_line == 0 || previous_line == LinePass::outside_line) {
+                    pass.outside_checks.emplace_back(previous_line, cursor);
+                } else if (continues && previous_line == 1) {
+                    pass.continues_line_before = true;
+                }
+            }
+            if (!pass.in_place) {
+                auto const previous = continues ? lines[previous_line].bounds : core::BoundingBox{};
+                auto result = t(lines, previous_line, style);
+                pass.moved_lines |= continues && lines[previous_line].bounds != previous;
+                pass.count = lines.size();
+                pass.last_line_laid_out |= pass.count != cursor;
+                return result;
+            }
+
+            pass.scratch_lines.clear();
+            if (continues) pass.scratch_lines.push_back(lines[previous_line]);
+            auto const first = pass.scratch_lines.size();
+            auto result = t(pass.scratch_lines, continues ? 0 : 1, style);
+            if (continues && pass.scratch_lines[0].bounds != lines[previous_line].bounds) {
+                lines[previous_line] = pass.scratch_lines[0];
+                pass.moved_lines = true;
+            }
+
+            auto const count = pass.scratch_lines.size() - first;
+            auto const new_lines = std::span(pass.scratch_lines).subspan(first);
+            if (count != old.size || (count != 0 && old.start != cursor)) {
+                pass.old_lines.assign(lines.begin() + static_cast<std::ptrdiff_t>(cursor), lines.end());
+                pass.old_lines_offset = cursor;
+                lines.resize(cursor);
+                lines.insert(lines.end(), new_lines.begin(), new_lines.end());
+                pass.in_place = false;
+            } else {
+                std::ranges::copy(new_lines, lines.begin() + static_cast<std::ptrdiff_t>(cursor));
+            }
+            pass.count = cursor + count;
+            pass.last_line_laid_out |= count != 0;
+            if (result.text_rendered != 0) result.span.start = static_cast<unsigned>(cursor);
+            return result;
+        }
+
+        // Keeps the lines of a skipped subtree.
+        auto reuse_lines(LinePass& pass, LayoutInputs const& last) -> void {
+            auto& lines = *pass.lines;
+            auto const count = last.line_end - last.line_begin;
+            if (!pass.in_place) {
+                auto first = pass.old_lines.begin() + static_cast<std::ptrdiff_t>(last.line_begin - pass.old_lines_offset);
+                lines.insert(lines.end(), first, first + static_cast<std::ptrdiff_t>(count));
+            }
+            pass.count += count;
+            if (count != 0) pass.last_line_laid_out = false;
+        }
+
+        // The state of the virtual list `node` for this layout.
+        auto attach_virtual_list(node_index_t node) -> VirtualList& {
+            auto const& el = nodes[node];
+            auto& list = m_virtual_lists[el.node_index];
+            if (!list.attached) {
+                for (auto c: children_of(node)) drop_lines(c);
+                list.laid_out.clear();
+                list.attached = true;
+            }
+            list.sync(children_of(node), styles[el.style_index].virtual_rows);
+            return list;
+        }
+
+        // Runs the style and width passes for a row of the virtual list `node`, which skip
+        // its rows, with what they would have passed it. A clean row given the same is kept.
+        auto prepare_row(xml::Context* context, node_index_t node, VirtualList const& list, node_index_t row) -> void {
+            auto& ch = nodes[row];
+            if (!ch.dirty) {
+                auto const fits = ch.last.width_unit == css::Unit::Auto;
+                if (same_size(ch.last.parent_width, list.parent_width)
+                    && same_size(ch.last.parent_height, list.parent_height)
+                    && ch.last.max_parent_width == list.max_parent_width
+                    && !(fits && ch.last.width_arg != list.width_arg)) {
+                    return;
+                }
+                mark_dirty(row);
+            }
+            reset_node(context, row);
+            resolve_child_style(styles[ch.style_index], list.parent_width, list.parent_height);
+            ch.last.parent_width = list.parent_width;
+            ch.last.parent_height = list.parent_height;
+            resolve_subtree_style(context, row);
+            if (!nodes[node].last.sized) return;
+            ch.last.max_parent_width = list.max_parent_width;
+            ch.last.width_arg = list.width_arg;
+            ch.last.width_unit = styles[ch.style_index].width.unit;
+            ch.last.width = resolve_child_width(context, row, list.max_parent_width, list.width_arg);
+        }
+
+        constexpr auto layout_threads() const noexcept -> std::size_t {
+            return parallel.threads ? parallel.threads : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // Runs `fn(i, worker)` for every `i` below `count` on up to `layout_threads()`
+        // threads of the layout's pool, the caller's as worker 0, and rethrows the first
+        // exception.
+        template <typename Fn>
+        auto run_parallel(std::size_t count, Fn&& fn) -> void {
+            if (count == 0) return;
+            auto const threads = std::min(layout_threads(), count);
+            auto next = std::atomic<std::size_t>{};
+            auto work = [&](std::size_t worker) {
+                for (auto i = next++; i < count; i = next++) fn(i, worker);
+            };
+            if (threads < 2) return work(0);
+
+            if (!m_pool) m_pool = std::make_unique<core::ThreadPool>();
+            m_pool->run(threads, work);
+        }
+
+        // Nodes in the subtree of `node` as it was built, in pre-order: from `node` to its
+        // last descendant. Nodes added since throw it off, so it is only a guess.
+        constexpr auto estimate_subtree(node_index_t node) const noexcept -> std::size_t {
+            auto last = node;
+            while (!nodes[last].children.empty()) last = children_of(last).back();
+            return last >= node ? last - node + 1 : 0;
+        }
+
+        // Whether every node in the subtree of `node` is laid out again and none is a
+        // virtual list, so that laying it out touches nothing outside it. `stack` is the
+        // calling worker's scratch.
+        auto is_detachable(node_index_t node, std::vector<node_index_t>& stack) const -> bool {
+            if (m_rebuilt && m_virtual_lists.empty()) return true;
+            stack.assign(1, node);
+            while (!stack.empty()) {
+                auto const top = stack.back();
+                stack.pop_back();
+                if (!nodes[top].dirty || styles[nodes[top].style_index].is_virtual_list()) return false;
+                auto const kids = children_of(top);
+                stack.insert(stack.end(), kids.begin(), kids.end());
+            }
+            return true;
+        }
+
+        // Lays out the large block children of `node` that start at its left edge, each
+        // one at the top of a layout of its own, on up to `layout_threads()` threads.
+        // Returns the ones laid out, or nothing if there were fewer than two to try.
+        auto fork_subtrees(xml::Context* context, node_index_t node, HeightResult const& param) -> std::vector<SubtreeTask> {
+            auto tasks = std::vector<SubtreeTask>{};
+            auto after_block = true;
+            auto const kids = children_of(node);
+            for (auto i = 0ul; i < kids.size(); ++i) {
+                auto const l = kids[i];
+                auto const& style = styles[nodes[l].style_index];
+                auto const is_block = !style.has_inline_flow();
+                if (is_block && after_block && nodes[l].dirty && estimate_subtree(l) >= parallel.min_subtree_nodes) {
+                    auto at = param;
+                    at.start_position = { i == 0 ? param.start_position.x : param.content.x, 0 };
+                    auto task = SubtreeTask{ .child = i, .node = l, .container = nodes[l].container };
+                    task.position = place_block(at, style, task.container);
+                    task.position.previous_line = LinePass::outside_line;
+                    tasks.push_back(std::move(task));
+                }
+                after_block = is_block;
+            }
+            if (tasks.size() < 2 || layout_threads() < 2) return {};
+
+            auto const threads = std::min(layout_threads(), tasks.size());
+            if (m_worker_caches.size() + 1 < threads) m_worker_caches.resize(threads - 1);
+            if (m_worker_stacks.size() < threads) m_worker_stacks.resize(threads);
+            run_parallel(tasks.size(), [&](std::size_t i, std::size_t worker) {
+                auto& task = tasks[i];
+                if (!is_detachable(task.node, m_worker_stacks[worker])) return;
+                task.lines.resize(2);
+                task.pass.lines = &task.lines;
+                task.pass.count = 2;
+                task.pass.cache = worker == 0 ? m_pass.cache : &m_worker_caches[worker - 1];
+                task.pass.detached = true;
+                task.result = resolve_cyclic_height(context, task.pass, task.node, task.position);
+            });
+            std::erase_if(tasks, [](SubtreeTask const& task) { return task.lines.empty(); });
+            return tasks;
+        }
+
+        // Whether `task` is what laying its child out at `at` would have given, moved
+        // down: it was placed the same, and no text in it would have continued a line
+        // before it. Notes where the child ended up in `task`.
+        auto can_merge(LinePass const& pass, SubtreeTask& task, HeightResult const& at, core::BoundingBox const& container) const -> bool {
+            task.base = pass.count;
+            task.dy = at.content.y - task.position.content.y;
+            task.previous_line = at.previous_line;
+
+            auto moved = task.container;
+            moved.y += task.dy;
+            if (moved != container || task.translate(task.position) != at) return false;
+
+            for (auto [previous_line, cursor]: task.pass.outside_checks) {
+                if (task.line(cursor) == task.line(previous_line) + 1) return false;
+            }
+            if (task.pass.continues_line_before && task.base != 0) {
+                auto const& line = (*pass.lines)[task.base - 1];
+                if (!(line.line.empty() || line.line == " ")) return false;
+            }
+            return true;
+        }
+
+        // Appends the lines of `task` where its child is placed and returns the child's
+        // height result. Its nodes are moved along by `rebase_subtree`.
+        auto merge_subtree(LinePass& pass, SubtreeTask& task) -> HeightResult {
+            auto& lines = *pass.lines;
+            if (pass.in_place) {
+                pass.old_lines.assign(lines.begin() + static_cast<std::ptrdiff_t>(task.base), lines.end());
+                pass.old_lines_offset = task.base;
+                lines.resize(task.base);
+                pass.in_place = false;
+            }
+            // Margins inside the subtree can move the line before it.
+            if (task.base != 0) lines[task.base - 1].bounds.y += task.lines[1].bounds.y;
+            for (auto line: std::span(task.lines).subspan(2)) {
+                line.bounds.y += task.dy;
+                lines.push_back(line);
+            }
+            pass.count = lines.size();
+            pass.last_line_laid_out |= task.pass.last_line_laid_out;
+            pass.moved_lines |= task.pass.moved_lines;
+            task.merged = true;
+            return task.translate(task.result);
+        }
+
+        // Moves the nodes of a merged subtree down with its lines, and their line spans
+        // along. The parent places the child itself.
+        auto rebase_subtree(SubtreeTask const& task) -> void {
+            auto stack = std::vector<node_index_t>{ task.node };
+            while (!stack.empty()) {
+                auto const n = stack.back();
+                stack.pop_back();
+                auto& ch = nodes[n];
+                // Texts without lines have an empty span at 0.
+                if (!ch.is_text() || !ch.lines.empty()) {
+                    auto const begin = task.line(ch.lines.start);
+                    auto const end = task.line(ch.lines.start + ch.lines.size);
+                    ch.lines = { .start = static_cast<unsigned>(begin), .size = static_cast<unsigned>(end - begin) };
+                }
+                if (n != task.node) {
+                    ch.container.y += task.dy;
+                    ch.last.position = task.translate(ch.last.position);
+                    ch.last.result = task.translate(ch.last.result);
+                    ch.last.line_begin = task.line(ch.last.line_begin);
+                    ch.last.line_end = task.line(ch.last.line_end);
+                }
+                auto const kids = children_of(n);
+                stack.insert(stack.end(), kids.begin(), kids.end());
+            }
+        }
+
+        // Moves the clean block `node` down to `at` with its subtree and lines when `at` is
+        // where it was placed last time moved down by as much, so that a child above it
+        // whose height changed does not lay out everything below it again. Returns false,
+        // moving nothing, if a text in it continued or would continue a line before it, or
+        // it holds a changed node or a virtual list.
+        auto translate_subtree(LinePass& pass, node_index_t node, HeightResult const& at) -> bool {
+            auto const& last = nodes[node].last;
+            auto const dy = at.content.y - last.position.content.y;
+            auto moved = last.position;
+            moved.content.y += dy;
+            moved.start_position.y += dy;
+            if (moved != at) return false;
+
+            auto const old_begin = last.line_begin;
+            auto const new_begin = pass.count;
+            auto const count = last.line_end - last.line_begin;
+            if (old_begin == 0 || new_begin == 0 || at.previous_line + 1 >= std::min(old_begin, new_begin)) return false;
+            if (pass.in_place) {
+                if (new_begin != old_begin) return false;
+            } else if (old_begin < pass.old_lines_offset || last.line_end - pass.old_lines_offset > pass.old_lines.size()) {
+                return false;
+            }
+
+            // Lines in the subtree move along; previous lines before it stay where they are,
+            // but for the one right before it.
+            auto shift = [&](std::size_t i) { return i + new_begin - old_begin; };
+            auto map_line = [&](std::size_t i) { return i == 0 || i + 1 < old_begin ? i : shift(i); };
+
+            auto& subtree = m_walk;
+            subtree.assign(1, node);
+            for (auto i = 0ul; i < subtree.size(); ++i) {
+                auto const& ch = nodes[subtree[i]];
+                if (ch.dirty || styles[ch.style_index].is_virtual_list()) return false;
+                if (ch.is_text()) {
+                    auto const previous = ch.last.position.previous_line;
+                    auto const continued = previous + 1 == ch.last.line_begin;
+                    if (continued && previous < old_begin) return false;
+                    if (continued != (map_line(previous) + 1 == shift(ch.last.line_begin))) return false;
+                }
+                auto const kids = children_of(subtree[i]);
+                subtree.insert(subtree.end(), kids.begin(), kids.end());
+            }
+
+            auto& lines = *pass.lines;
+            if (!pass.in_place) {
+                auto first = pass.old_lines.begin() + static_cast<std::ptrdiff_t>(old_begin - pass.old_lines_offset);
+                lines.insert(lines.end(), first, first + static_cast<std::ptrdiff_t>(count));
+            }
+            for (auto j = new_begin; j < new_begin + count; ++j) lines[j].bounds.y += dy;
+            pass.count += count;
+            if (count != 0) pass.last_line_laid_out = false;
+
+            auto move = [&](HeightResult r) {
+                r.content.y += dy;
+                r.start_position.y += dy;
+                r.previous_line = map_line(r.previous_line);
+                return r;
+            };
+            for (auto n: subtree) {
+                auto& ch = nodes[n];
+                ch.container.y += dy;
+                // Texts without lines have an empty span at 0.
+                if (!ch.is_text() || !ch.lines.empty()) ch.lines.start = static_cast<unsigned>(shift(ch.lines.start));
+                ch.last.position = move(ch.last.position);
+                ch.last.result = move(ch.last.result);
+                ch.last.line_begin = shift(ch.last.line_begin);
+                ch.last.line_end = shift(ch.last.line_end);
+                if (dy != 0 && !m_canvases.empty()) {
+                    if (auto it = m_canvases.find(n); it != m_canvases.end()) it->second.dirty = true;
+                }
+            }
+            return true;
+        }
+
+        // Places a block child below the children before it, at `at`, and moves its
+        // container there. Where it starts is all that depends on them: moving `at` down
+        // moves the result down by as much.
+        static constexpr auto place_block(HeightResult at, css::LayoutStyle const& style, core::BoundingBox& container) noexcept -> HeightResult {
+            auto const offset_x = style.padding.left.as_cell() + style.border_left_width + style.margin.left.as_cell();
+            auto const offset_y = style.padding.top.as_cell() + style.border_top_width;
+            auto const x = at.start_position.x;
+            auto const y = at.start_position.y + at.height;
+            container.width -= x - container.x;
+            container.x = x;
+            container.y = y;
+
+            auto width = std::max(at.content.width - (style.padding.horizontal() + style.border_right_width + style.border_left_width + style.margin.horizontal()), 0);
+            auto tmp = at;
+            tmp.content = {
+                .x = x + offset_x,
+                .y = y + offset_y,
+                .width = std::min(std::max(at.content.x + width - x - offset_x, 0), container.width),
+                .height = 0
+            };
+            tmp.height = 0;
+            tmp.start_position = { tmp.content.x, tmp.content.y };
+            return tmp;
+        }
 
         constexpr auto resolve_cyclic_height(
             xml::Context* context,
+            LinePass& pass,
             node_index_t node,
             HeightResult param
         ) -> HeightResult {
             auto& el = nodes[node];
-            auto& p_style = context->styles[el.style_index];
-            if (!el.text.empty()) {
+            auto& p_style = styles[el.style_index];
+            el.dirty = false;
+            if (el.is_text()) {
                 auto t = TextLayouter {
                     .text = el.text,
+                    .breaks = &el.breaks,
+                    .cache = pass.cache,
                     .container = {
                         .x = param.content.x,
                         .y = param.content.y,
                         .width = param.content.width,
-                        .height = core::BoundingBox::inf().height - param.content.y // avoid overflow
+                        // avoid overflow; rows of a scrolled list start above zero
+                        .height = core::BoundingBox::inf().height - std::max(param.content.y, 0)
                     },
                     .start_position = param.start_position,
                 };
 
-                auto result = t(lines, param.previous_line, p_style);
+                auto result = layout_text(pass, t, param.previous_line, p_style, el.lines);
                 el.lines = result.span;
                 return {
                     .height = result.container.height,
@@ -395,15 +1305,54 @@ namespace termml::layout {
             auto is_previous_inline = false;
 
             param.height = 0;
+
+            // A virtual list lays out the rows from just above its view to just below it,
+            // starting at the first one's offset.
+            auto* list = p_style.is_virtual_list() ? &attach_virtual_list(node) : nullptr;
+            auto const kids = children_of(node);
+            auto first = std::size_t{};
+            auto end = kids.size();
+            auto const origin_y = param.start_position.y;
+            auto const view = p_style.height.is_absolute() ? p_style.height.i : viewport.height;
+            auto bottom = origin_y;
+            auto rows_below = std::size_t{};
+            auto requested = 0;
+            if (list) {
+                requested = list->scroll;
+                list->scroll = std::clamp(list->scroll, 0, std::max(list->heights.total() - view, 0));
+                first = list->heights.row_at(list->scroll);
+                first -= std::min(first, VirtualList::overscan);
+                param.start_position.y += list->heights.offset(first) - list->scroll;
+                bottom = origin_y + view;
+            }
             auto tmp_param = param;
+            // Large blocks are laid out on other threads first and merged when reached.
+            auto tasks = list || pass.detached || p_style.has_inline_flow() || parallel.threads == 1
+                ? std::vector<SubtreeTask>{}
+                : fork_subtrees(context, node, param);
+            auto next_task = tasks.begin();
 
-            auto line_start = std::max<std::size_t>(lines.size(), 1) - 1;
+            auto line_start = std::max<std::size_t>(pass.count, 1) - 1;
             auto margin_line_start = line_start;
-            auto margin_node_start = std::size_t{};
-            for (auto i = std::size_t{}; i < el.children.size(); ++i) {
-                auto l = el.children[i];
+            auto margin_node_start = first;
+            auto shift_lines = [&pass, &margin_line_start](int dy) {
+                for (auto j = margin_line_start; j < pass.count; ++j) {
+                    (*pass.lines)[j].bounds.y += dy;
+                }
+                if (dy != 0) pass.moved_lines = pass.last_line_laid_out = true;
+            };
+            for (auto i = first; i < end; ++i) {
+                auto l = kids[i];
+                auto const row_top = param.start_position.y;
+                if (list) {
+                    if (row_top >= bottom && rows_below++ == VirtualList::overscan) {
+                        end = i;
+                        break;
+                    }
+                    prepare_row(context, node, *list, l);
+                }
                 auto& ch = nodes[l];
-                auto& style = context->styles[ch.style_index];
+                auto& style = styles[ch.style_index];
 
                 auto top_margin = style.margin.top.as_cell();
                 auto bottom_margin = style.margin.bottom.as_cell();
@@ -445,58 +1394,78 @@ namespace termml::layout {
                     std::max(v_padding.second, bottom_padding),
                 };
 
-                auto tmp = tmp_param;
-                auto offset_x = style.padding.left.as_cell() + style.border_left.border_width() + style.margin.left.as_cell();
-                auto offset_y = top_padding + style.border_top.border_width();
-                tmp.start_position = {
-                    .x = tmp_param.start_position.x + offset_x,
-                    .y = tmp_param.start_position.y + offset_y
-                };
-
+                auto offset_x = style.padding.left.as_cell() + style.border_left_width + style.margin.left.as_cell();
+                auto offset_y = top_padding + style.border_top_width;
                 auto is_inline = style.has_inline_flow();
 
-                if (!is_inline) {
-                    tmp.content.x = tmp_param.start_position.x;
-                    tmp.content.y = tmp_param.start_position.y + tmp_param.height;
-                    auto x_shift = tmp.content.x - ch.container.x;
-                    ch.container.x = tmp.content.x;
-                    ch.container.y = tmp.content.y;
-                    ch.container.width -= x_shift;
-                    tmp.content.x += offset_x;
-                    tmp.content.y += offset_y;
-
-                    auto width = std::max(tmp_param.content.width - (style.padding.horizontal() + style.border_right.border_width() + style.border_left.border_width() + style.margin.horizontal()), 0);
-
-                    tmp.content = core::BoundingBox::from(
-                        tmp.content.x,
-                        tmp_param.content.x + width,
-                        tmp.content.y,
-                        core::BoundingBox::inf().y - tmp.content.y
-                    );
-
-                    tmp.height = tmp_param.height = 0;
-                    tmp.start_position = { tmp.content.x, tmp.content.y };
-                    tmp.content.width = std::min(tmp.content.width, ch.container.width);
-                } else {
-                    ch.container.width -= (tmp.content.x - ch.container.x);
-                    ch.container.x = tmp.content.x;
-                    ch.container.y = tmp.content.y;
-                }
+                // Places the child's container, which holds its width from the width pass.
+                auto place = [&](core::BoundingBox& container) {
+                    if (!is_inline) return place_block(tmp_param, style, container);
 
+                    auto tmp = tmp_param;
+                    tmp.start_position = {
+                        .x = tmp_param.start_position.x + offset_x,
+                        .y = tmp_param.start_position.y + offset_y
+                    };
+                    container.width -= (tmp.content.x - container.x);
+                    container.x = tmp.content.x;
+                    container.y = tmp.content.y;
 
-                if (is_previous_inline && style.is_inline_context()) {
-                    tmp.previous_line = std::max(lines.size(), std::size_t{1}) - 1;
-                }
+                    if (is_previous_inline && style.is_inline_context()) {
+                        tmp.previous_line = std::max(pass.count, std::size_t{1}) - 1;
+                    }
+                    return tmp;
+                };
 
-                tmp = resolve_cyclic_height(context, l, tmp);
-                if (style.height.is_fit()) {
-                    ch.container.height = tmp.height;
-                } else if (style.height.is_absolute()) {
-                    ch.container.height = style.height.i;
+                // A clean child placed where it was, after the same lines, is kept as it is.
+                // A text continuing a line laid out in this pass may wrap it, so it is not.
+                // A child laid out on another thread is merged if it was placed the same.
+                auto* task = next_task != tasks.end() && next_task->child == i ? &*next_task++ : nullptr;
+                auto container = ch.dirty || task ? ch.container : core::BoundingBox{ .width = ch.last.container_width };
+                auto tmp = place(container);
+                auto const merged = task && can_merge(pass, *task, tmp, container);
+                auto const reuse = !ch.dirty && !task
+                    && ch.last.position == tmp
+                    && ch.last.line_begin == pass.count
+                    && !(pass.last_line_laid_out && pass.count == tmp.previous_line + 1);
+                // A clean block only moved by the children above it is moved along with them.
+                auto const translated = !ch.dirty && !task && !reuse && !is_inline && !list && !pass.detached
+                    && translate_subtree(pass, l, tmp);
+                if (!ch.dirty && !reuse && !merged && !translated) {
+                    if (task) drop_lines(l);
+                    restyle_child(context, l);
+                    if (el.last.sized) {
+                        ch.last.width = resolve_child_width(context, l, ch.last.max_parent_width, ch.last.width_arg);
+                    }
+                    container = ch.container;
+                    tmp = place(container);
+                }
+                // Blocks start below the lines before them.
+                if (!is_inline) tmp_param.height = 0;
+
+                if (reuse) {
+                    tmp = ch.last.result;
+                    reuse_lines(pass, ch.last);
+                } else if (translated) {
+                    tmp = ch.last.result;
                 } else {
-                    ch.container.height = 0;
+                    ch.last.container_width = ch.container.width;
+                    ch.last.position = tmp;
+                    ch.last.line_begin = pass.count;
+                    ch.container = container;
+                    tmp = merged ? merge_subtree(pass, *task) : resolve_cyclic_height(context, pass, l, tmp);
+                    ch.last.result = tmp;
+                    ch.last.line_end = pass.count;
+
+                    if (style.height.is_fit()) {
+                        ch.container.height = tmp.height;
+                    } else if (style.height.is_absolute()) {
+                        ch.container.height = style.height.i;
+                    } else {
+                        ch.container.height = 0;
+                    }
+                    ch.container.height += style.padding.vertical() + style.border_bottom_width + style.border_top_width;
                 }
-                ch.container.height += style.padding.vertical() + style.border_bottom.border_width() + style.border_top.border_width();
 
                 auto moved_to_new_line = (tmp.start_position.y != tmp_param.start_position.y);
 
@@ -506,11 +1475,9 @@ namespace termml::layout {
                 height += ch.container.height;
 
                 if (moved_to_new_line || !is_inline) {
-                    for (auto j = margin_line_start; j < lines.size(); ++j) {
-                        lines[j].bounds.y += v_margin.first;
-                    }
+                    shift_lines(v_margin.first);
                     for (auto j = margin_node_start; j < i; ++j) {
-                        nodes[el.children[j]].container.y += v_margin.first;
+                        nodes[kids[j]].container.y += v_margin.first;
                     }
 
                     height += v_margin.first;
@@ -518,7 +1485,7 @@ namespace termml::layout {
 
                     v_margin = { v_margin.second, 0 };
                     v_padding = {};
-                    margin_line_start = lines.size();
+                    margin_line_start = pass.count;
                     margin_node_start = i + 1;
                 }
 
@@ -540,17 +1507,38 @@ namespace termml::layout {
                 }
 
                 is_previous_inline = is_inline;
-                resolve_style_height_releated_props(style, ch.container.height, true);
+                if (!reuse && !translated) resolve_style_height_releated_props(style, ch.container.height, true);
+                // Rows are blocks, so this is the row with the margin above it.
+                if (list) list->heights.set(i, param.start_position.y - row_top);
             }
 
-            for (auto j = margin_line_start; j < lines.size(); ++j) {
-                lines[j].bounds.y += v_margin.first;
+            shift_lines(v_margin.first);
+            for (auto j = margin_node_start; j < end; ++j) {
+                nodes[kids[j]].container.y += v_margin.first;
             }
-            for (auto j = margin_node_start; j < el.children.size(); ++j) {
-                nodes[el.children[j]].container.y += v_margin.first;
+            if (!tasks.empty()) {
+                std::erase_if(tasks, [](SubtreeTask const& task) { return !task.merged; });
+                run_parallel(tasks.size(), [&tasks, this](std::size_t i, std::size_t) { rebase_subtree(tasks[i]); });
             }
 
-            param.height += tmp_param.height;
+            if (list) {
+                auto const rows = kids.subspan(first, end - first);
+                for (auto r: list->laid_out) {
+                    if (std::ranges::find(rows, r) == rows.end()) drop_lines(r);
+                }
+                list->laid_out.assign(rows.begin(), rows.end());
+                // Rows measured taller or shorter than estimated moved the end of the list;
+                // one scrolled past it is laid out again in the next `compute`.
+                if (auto const scroll = std::clamp(requested, 0, std::max(list->heights.total() - view, 0)); scroll != list->scroll) {
+                    list->scroll = scroll;
+                    m_scrolled.push_back(el.node_index);
+                }
+                // The list takes up all its rows, measured or estimated.
+                param.start_position.y = origin_y;
+                param.height = list->heights.total();
+            } else {
+                param.height += tmp_param.height;
+            }
             if (p_style.has_inline_flow()) {
                 param.start_position = tmp_param.start_position;
             } else {
@@ -558,7 +1546,7 @@ namespace termml::layout {
                 param.start_position.y += param.height;
             }
 
-            auto line_end = lines.size();
+            auto line_end = pass.count;
             el.lines = {
                 .start = static_cast<unsigned>(line_start),
                 .size = static_cast<unsigned>(line_end - line_start)
@@ -581,7 +1569,7 @@ namespace termml::layout {
         //     el.scrollable_y = (el.container.max_y() > container.max_y() || el.container.min_y() < container.min_y());
         //     for (auto c: el.children) {
         //         auto& ch = nodes[c];
-        //         auto const& style = context->styles[ch.style_index];
+        //         auto const& style = styles[ch.style_index];
         //         ch.container.x = x;
         //         ch.container.y = y;
         //
@@ -609,36 +1597,55 @@ namespace termml::layout {
             bool is_next_element_inline = false
         ) -> void {
             auto& el = nodes[node];
-            auto const& style = context->styles[el.style_index];
+            auto const& style = paint_styles[el.style_index];
 
-            if (el.tag.empty() && node != 0) {
+            if (el.is_text()) {
                 for (auto i = 0ul; i < el.lines.size; ++i) {
                     auto const& line = lines[el.lines.start + i];
                     // std::println("HERE: {} | {}", line.line, line.bounds);
-                    dev.write_text(line.line, line.bounds.x, line.bounds.y, core::PixelStyle::from_style(style));
+                    dev.write_text(line.line, line.bounds.x, line.bounds.y, core::PixelStyle::from_style(style, m_palette));
                 }
                 return;
             }
 
             if (!ignore_scroll && (el.scrollable_x || el.scrollable_y)) {
-                auto d = core::Device(&el.canvas);
-                render_node(d, context, node, el.container, true);
+                auto& canvas = m_canvases[node];
+                if (canvas.dirty) {
+                    auto d = core::Device(&canvas.terminal);
+                    render_node(d, context, node, el.container, true);
+                    canvas.dirty = false;
+                }
                 core::ViewportClipGuard clip(dev, container);
-                for (auto r = 0; r < el.canvas.rows(); ++r) {
-                    for (auto c = 0; c < el.canvas.cols(); ++c) {
-                        auto const& cell = el.canvas(static_cast<unsigned>(r), static_cast<unsigned>(c));
+                for (auto r = 0; r < canvas.terminal.rows(); ++r) {
+                    for (auto c = 0; c < canvas.terminal.cols(); ++c) {
+                        auto const& cell = canvas.terminal(static_cast<unsigned>(r), static_cast<unsigned>(c));
+                        // Drawn with the wide glyph to its left.
+                        if (cell.is_continuation()) continue;
                         auto x = c + el.container.x;
                         auto y = r + el.container.y;
                         dev.put_pixel(cell.text(), x, y, cell.style);
                     }
                 }
+            } else if (styles[el.style_index].is_virtual_list()) {
+                // The rows at the edges stick out of the content box.
+                auto const& ls = styles[el.style_index];
+                auto const content = el.container.pad(
+                    ls.border_top_width + ls.padding.top.as_cell(),
+                    ls.border_right_width + ls.padding.right.as_cell(),
+                    ls.border_bottom_width + ls.padding.bottom.as_cell(),
+                    ls.border_left_width + ls.padding.left.as_cell()
+                );
+                core::ViewportClipGuard clip(dev, content.intersection(dev.viewport()));
+                for (auto c: visible_rows(el.node_index)) {
+                    auto const& ch = nodes[c];
+                    render_node(dev, context, c, ch.is_text() ? container : ch.container, false, is_next_element_inline);
+                }
             } else {
                 // core::ViewportClipGuard g(dev, container);
-                for (auto i = 0ul; i < el.children.size(); ++i) {
-                    auto c = el.children[i];
+                for (auto c: children_of(node)) {
                     auto const& ch = nodes[c];
 
-                    if (ch.tag.empty()) {
+                    if (ch.is_text()) {
                         // std::println("HERE: \t\t\t\t\t\t\t\t{} | '{}' | {}, {}", ch.viewport, ch.text, ch.content_offset_x, ch.content_offset_y);
                         render_node(dev, context, c, container, false, is_next_element_inline);
                     } else {
@@ -648,12 +1655,12 @@ namespace termml::layout {
             }
 
             auto [tl_border_style, tr_border_style, br_border_style, bl_border_style] = style.border_type;
-            auto border_style = core::PixelStyle::from_style(style);
+            auto border_style = core::PixelStyle::from_style(style, m_palette);
             if (style.border_top.width.as_cell() != 0) {
                 // top
                 auto set = style.border_top.char_set(tl_border_style);
 
-                border_style.fg_color = style.border_top.color;
+                border_style.fg_color = m_palette.resolve(style.border_top.color);
                 for (auto c = el.container.min_x(); c < el.container.max_x(); ++c) {
                     auto r = el.container.min_y();
                     dev.put_pixel(set.horizonal, c, r, border_style);
@@ -664,7 +1671,7 @@ namespace termml::layout {
                 // bottom
                 auto set = style.border_bottom.char_set(tl_border_style);
 
-                border_style.fg_color = style.border_bottom.color;
+                border_style.fg_color = m_palette.resolve(style.border_bottom.color);
                 for (auto c = el.container.min_x(); c < el.container.max_x(); ++c) {
                     auto r = el.container.max_y() - 1;
                     dev.put_pixel(set.horizonal, c, r, border_style);
@@ -675,7 +1682,7 @@ namespace termml::layout {
                 // left
                 auto set = style.border_left.char_set(tl_border_style);
 
-                border_style.fg_color = style.border_left.color;
+                border_style.fg_color = m_palette.resolve(style.border_left.color);
                 for (auto r = el.container.min_y(); r < el.container.max_y(); ++r) {
                     auto c = el.container.min_x();
                     dev.put_pixel(set.vertical, c, r, border_style);
@@ -686,7 +1693,7 @@ namespace termml::layout {
                 // right
                 auto set = style.border_right.char_set(tl_border_style);
 
-                border_style.fg_color = style.border_right.color;
+                border_style.fg_color = m_palette.resolve(style.border_right.color);
                 for (auto r = el.container.min_y(); r < el.container.max_y(); ++r) {
                     auto c = el.container.max_x() - 1;
                     dev.put_pixel(set.vertical, c, r, border_style);
@@ -700,7 +1707,7 @@ namespace termml::layout {
                 }
 
                 if (!corner.empty()) {
-                    border_style.fg_color = style.border_left.color;
+                    border_style.fg_color = m_palette.resolve(style.border_left.color);
                     dev.put_pixel(corner, el.container.min_x(), el.container.min_y(), border_style);
                 }
                 corner = {};
@@ -711,7 +1718,7 @@ namespace termml::layout {
                 }
 
                 if (!corner.empty()) {
-                    border_style.fg_color = style.border_right.color;
+                    border_style.fg_color = m_palette.resolve(style.border_right.color);
                     dev.put_pixel(corner, el.container.max_x() - 1, el.container.min_y(), border_style);
                 }
                 corner = {};
@@ -722,7 +1729,7 @@ namespace termml::layout {
                 }
 
                 if (!corner.empty()) {
-                    border_style.fg_color = style.border_right.color;
+                    border_style.fg_color = m_palette.resolve(style.border_right.color);
                     dev.put_pixel(corner, el.container.max_x() - 1, el.container.max_y() - 1, border_style);
                 }
                 corner = {};
@@ -733,11 +1740,46 @@ namespace termml::layout {
                 }
 
                 if (!corner.empty()) {
-                    border_style.fg_color = style.border_left.color;
+                    border_style.fg_color = m_palette.resolve(style.border_left.color);
                     dev.put_pixel(corner, el.container.min_x(), el.container.max_y() - 1, border_style);
                 }
             }
         }
+
+    private:
+        xml::Context const* m_context{};
+        xml::generation_t m_generation{};
+        core::BoundingBox m_viewport{};
+        css::Palette m_palette{};
+        // Layout node of every document element laid out so far.
+        std::vector<node_index_t> m_element_nodes{};
+        // The height pass over the tree, which writes into `lines`.
+        LinePass m_pass{};
+        LineCache m_line_cache{};
+        // Whether the tree was built in this layout, which lays out every node.
+        bool m_rebuilt{false};
+        // Line caches of the threads other than the caller's.
+        std::vector<LineCache> m_worker_caches{};
+        // Scratch of `is_detachable`, by worker.
+        std::vector<std::vector<node_index_t>> m_worker_stacks{};
+        // Threads of the parallel layout, started on first use; see `parallel`.
+        std::unique_ptr<core::ThreadPool> m_pool{};
+        // Keyed by document element, so scroll offsets outlive the layout tree.
+        std::unordered_map<node_index_t, VirtualList> m_virtual_lists{};
+        // Elements scrolled since the last layout.
+        std::vector<node_index_t> m_scrolled{};
+        // Keyed by layout node; only scroll containers that were drawn have one.
+        std::unordered_map<node_index_t, Canvas> m_canvases{};
+        // Entries of `children` no node points at any more.
+        std::size_t m_dead_children{};
+        // Children of the nodes `update_children` is on, innermost last.
+        std::vector<node_index_t> m_child_scratch{};
+        // Stacks of `mark_dirty`/`drop_lines` and of `resolve_subtree_style`, kept so that
+        // laying out again does not allocate. They are only used on the calling thread:
+        // subtrees laid out on other threads are all dirty, so nothing in them is
+        // restyled or dropped.
+        std::vector<node_index_t> m_walk{};
+        std::vector<node_index_t> m_style_walk{};
     };
 
 } // namespace termml::layout
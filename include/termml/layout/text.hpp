@@ -4,10 +4,17 @@
 #include "../css/style.hpp"
 #include "../core/bounding_box.hpp"
 #include "../core/point.hpp"
+#include "../core/unicode.hpp"
 #include "../core/utf8.hpp"
 #include "line_box.hpp"
-#include <cassert>
+#include <algorithm>
 #include <cctype>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <span>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace termml::layout {
@@ -29,35 +36,199 @@ namespace termml::layout {
         }
     } // namespace detail
 
+    // Where a text may wrap and how many cells its parts take up. Built once when the text
+    // changes, so wrapping it at another width does not decode it again. Every whitespace
+    // byte is a break opportunity and `words` holds the runs between them, empty ones
+    // included: word `i + 1` starts right after the whitespace that ends word `i`. Widths
+    // are counted per grapheme cluster.
+    struct BreakIndex {
+        struct Word {
+            std::uint32_t begin{};
+            std::uint32_t end{};
+            // Display width of the text before the word.
+            std::uint32_t offset{};
+            std::uint32_t width{};
+        };
+
+        std::vector<Word> words{};
+        // Display width of the widest '\n'-separated line.
+        std::uint32_t max_line_width{};
+        std::size_t hash{};
+
+        static auto build(std::string_view text) -> BreakIndex {
+            auto res = BreakIndex{};
+            res.assign(text);
+            return res;
+        }
+
+        // Indexes `text` in place of what was indexed, reusing the storage of `words`.
+        auto assign(std::string_view text) -> void {
+            words.clear();
+            max_line_width = 0;
+            hash = std::hash<std::string_view>{}(text);
+            auto word = Word{};
+            auto line_width = std::uint32_t{};
+            auto add_width = [&](std::uint32_t n) {
+                word.width += n;
+                line_width += n;
+                max_line_width = std::max(max_line_width, line_width);
+            };
+            for (auto i = std::size_t{}; i < text.size();) {
+                // Eight printable ASCII characters at a time, unless the next one could
+                // join the last of them in a grapheme cluster.
+                if (i + 8 <= text.size() && (i + 8 == text.size() || static_cast<std::uint8_t>(text[i + 8]) < 0x80)) {
+                    auto w = core::utf8::detail::load(text, i);
+                    if (core::utf8::detail::is_ascii(w) && !core::utf8::detail::has_less(w, 0x21)) {
+                        add_width(8);
+                        i += 8;
+                        continue;
+                    }
+                }
+                if (std::isspace(text[i])) {
+                    word.end = static_cast<std::uint32_t>(i);
+                    words.push_back(word);
+                    word = { .begin = word.end + 1, .offset = word.offset + word.width + 1 };
+                    line_width = text[i] == '\n' ? 0 : line_width + 1;
+                    ++i;
+                    continue;
+                }
+                auto const cluster = core::unicode::cluster_at(text, i);
+                add_width(static_cast<std::uint32_t>(cluster.width));
+                i = cluster.end;
+            }
+            word.end = static_cast<std::uint32_t>(text.size());
+            words.push_back(word);
+        }
+
+        // Display width of the whole text.
+        constexpr auto width() const noexcept -> int {
+            if (words.empty()) return 0;
+            return static_cast<int>(words.back().offset + words.back().width);
+        }
+    };
+
+    // Least recently used wrapped texts. A text wraps the same way wherever it starts, as
+    // long as it starts at the same column of an equally wide container with the same
+    // wrapping style, so its lines are stored relative to where it started and only
+    // moved on a hit. Repeated rows and unchanged panes skip wrapping altogether.
+    struct LineCache {
+        struct Key {
+            std::size_t text_hash{};
+            int width{};
+            // Where the text starts, and where it was asked to start before wrapping its
+            // predecessor moved it; the first line is measured from the latter.
+            int column{};
+            int start_column{};
+            css::Whitespace whitespace{};
+            css::OverflowWrap overflow_wrap{};
+
+            constexpr auto operator==(Key const&) const noexcept -> bool = default;
+
+            constexpr auto hash() const noexcept -> std::size_t {
+                auto h = text_hash;
+                auto mix = [&h](std::size_t v) { h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2); };
+                mix(static_cast<std::size_t>(width));
+                mix(static_cast<std::size_t>(column));
+                mix(static_cast<std::size_t>(start_column));
+                mix(static_cast<std::size_t>(whitespace));
+                mix(static_cast<std::size_t>(overflow_wrap));
+                return h;
+            }
+        };
+
+        struct Line {
+            // Byte range in the text.
+            std::uint32_t offset{};
+            std::uint32_t size{};
+            // Relative to the container's left edge and the row the text started on.
+            core::BoundingBox bounds{};
+        };
+
+        struct Entry {
+            Key key{};
+            std::string text{};
+            std::vector<Line> lines{};
+            // Relative like the lines.
+            core::BoundingBox box{};
+            core::Point end{};
+        };
+
+        explicit LineCache(std::size_t capacity = 1024)
+            : m_capacity(capacity)
+        {}
+
+        auto find(Key const& key, std::string_view text) -> Entry const* {
+            auto it = m_index.find(key.hash());
+            if (it == m_index.end()) return nullptr;
+            auto entry = it->second;
+            if (entry->key != key || entry->text != text) return nullptr;
+            m_entries.splice(m_entries.begin(), m_entries, entry);
+            return &*entry;
+        }
+
+        // The most recently used entry, holding `key` and `text` and no lines yet, or null
+        // when nothing is cached. An entry with the same hash, or the least recently used
+        // one once the cache is full, is taken over along with its storage, so a full
+        // cache stops allocating.
+        auto insert(Key const& key, std::string_view text) -> Entry* {
+            if (m_capacity == 0) return nullptr;
+            auto h = key.hash();
+            if (auto it = m_index.find(h); it != m_index.end()) {
+                m_entries.splice(m_entries.begin(), m_entries, it->second);
+            } else if (m_entries.size() == m_capacity) {
+                auto node = m_index.extract(m_entries.back().key.hash());
+                m_entries.splice(m_entries.begin(), m_entries, std::prev(m_entries.end()));
+                node.key() = h;
+                node.mapped() = m_entries.begin();
+                m_index.insert(std::move(node));
+            } else {
+                m_entries.emplace_front();
+                m_index.emplace(h, m_entries.begin());
+            }
+            auto& entry = m_entries.front();
+            entry.key = key;
+            entry.text.assign(text);
+            entry.lines.clear();
+            return &entry;
+        }
+
+        auto clear() -> void {
+            m_entries.clear();
+            m_index.clear();
+        }
+
+        auto size() const noexcept -> std::size_t {
+            return m_entries.size();
+        }
+
+    private:
+        std::size_t m_capacity;
+        // Most recently used first.
+        std::list<Entry> m_entries{};
+        std::unordered_map<std::size_t, std::list<Entry>::iterator> m_index{};
+    };
+
     struct TextLayouter {
         std::string_view text;
+        // Built from `text` on every call when not given.
+        BreakIndex const* breaks{nullptr};
+        // Wrapped texts are looked up and stored here when given.
+        LineCache* cache{nullptr};
         // Scroll container
         core::BoundingBox container{core::BoundingBox::inf()};
         // position within the scroll container
         core::Point start_position{};
 
         // Message content width; ignore padding and margin
-        constexpr auto measure_width() const noexcept -> int {
-            std::size_t width{};
-            auto start = std::size_t{};
-            auto it = std::min(text.find('\n'), text.size());
-            while (it < text.size()) {
-                auto txt = text.substr(start, it);
-                width = std::max<std::size_t>(width, core::utf8::calculate_size(txt));
-                start = it + 1;
-                it = std::min(text.find('\n', start), text.size());
-            }
-
-            auto txt = text.substr(start);
-            width = std::max<std::size_t>(width, core::utf8::calculate_size(txt));
-
-            return static_cast<int>(width);
+        auto measure_width() const -> int {
+            if (breaks) return static_cast<int>(breaks->max_line_width);
+            return static_cast<int>(BreakIndex::build(text).max_line_width);
         }
 
         auto operator()(
             std::vector<layout::LineBox>& lines,
             std::size_t previous_text,
-            css::Style const& style
+            css::LayoutStyle const& style
         ) -> TextRenderResult {
             //  |---------------------Scroll Container-------------------|
             //  |               |--------ViewBox---------|               |
@@ -87,7 +258,11 @@ namespace termml::layout {
             auto x = container.x + dx;
             auto y = container.y + dy;
 
-            auto len = static_cast<int>(core::utf8::calculate_size(text));
+            auto local_breaks = BreakIndex{};
+            if (!breaks) local_breaks = BreakIndex::build(text);
+            auto const& index = breaks ? *breaks : local_breaks;
+
+            auto len = index.width();
 
             { // check if it's a continuation of the sentence.
                 if (lines.size() == previous_text + 1) {
@@ -114,14 +289,40 @@ namespace termml::layout {
                     .line = text,
                     .bounds = { x, y, len, 1 }
                 });
-                auto w = static_cast<int>(core::utf8::calculate_size(text));
-                box.width = w;
+                box.width = len;
                 box.x = x;
                 box.y = y;
                 start_position = { box.max_x(), y };
                 return { .container = box, .text_rendered = text.size(), .span = span };
             }
 
+            // Wrapping stops at the container's bottom edge, so only texts that stayed
+            // above it are cached.
+            auto key = LineCache::Key {
+                .text_hash = index.hash,
+                .width = container.width,
+                .column = x - container.x,
+                .start_column = dx,
+                .whitespace = style.whitespace,
+                .overflow_wrap = style.overflow_wrap
+            };
+            if (cache) {
+                if (auto entry = cache->find(key, text); entry && y + entry->end.y < container.max_y()) {
+                    for (auto const& l: entry->lines) {
+                        auto bounds = l.bounds;
+                        bounds.x += container.x;
+                        bounds.y += y;
+                        lines.push_back({ .line = text.substr(l.offset, l.size), .bounds = bounds });
+                    }
+                    box = entry->box;
+                    box.x += container.x;
+                    box.y += y;
+                    start_position = { .x = entry->end.x + container.x, .y = entry->end.y + y };
+                    auto size = static_cast<unsigned>(lines.size()) - line_start;
+                    return { .container = box, .text_rendered = text.size(), .span = { line_start, size } };
+                }
+            }
+
             box.x = x;
             box.y = y;
             box.width = std::min(
@@ -130,6 +331,7 @@ namespace termml::layout {
             );
 
             auto start = std::size_t{};
+            auto word = std::size_t{};
             auto start_y = y;
             auto max_x = x;
             do {
@@ -157,10 +359,11 @@ namespace termml::layout {
                         max_x = std::max(max_x, x);
                     }
                     start += 1;
+                    ++word;
                 }
-                auto pos = detail::find_word(text, start);
+                auto pos = std::size_t{index.words[word].end};
                 auto txt = text.substr(start, pos - start);
-                auto sz = static_cast<int>(core::utf8::calculate_size(txt));
+                auto sz = static_cast<int>(index.words[word].width);
 
                 if (x - dx + sz > container.max_x()) {
                     if (x != container.min_x()) {
@@ -178,12 +381,12 @@ namespace termml::layout {
                         auto last_text_end = std::size_t{};
                         auto last_x_start = x;
                         auto w = 0;
-                        for (auto i = std::size_t{}; i < txt.size(); ++x) {
-                            auto l = core::utf8::get_length(txt[i]);
+                        for (auto i = std::size_t{}; i < txt.size();) {
+                            auto [end, cw] = core::unicode::cluster_at(txt, i);
                             max_x = std::max(max_x, x);
-                            if (x + static_cast<int>(l) > container.max_x()) {
+                            if (x + cw > container.max_x()) {
                                 lines.push_back({
-                                    .line = txt.substr(last_text_end, i),
+                                    .line = txt.substr(last_text_end, i - last_text_end),
                                     .bounds = { last_x_start, y, w, 1 }
                                 });
                                 ++y;
@@ -197,9 +400,9 @@ namespace termml::layout {
                                 if (y >= container.max_y()) break;
                             }
 
-                            assert(i + l <= txt.size());
-                            i += l;
-                            ++w;
+                            i = end;
+                            w += cw;
+                            x += cw;
                         }
                         if (last_text_end != txt.size()) {
                             lines.push_back({
@@ -233,6 +436,24 @@ namespace termml::layout {
 
             auto size = static_cast<unsigned>(lines.size()) - line_start;
             auto span = LineSpan{ line_start, size };
+
+            if (auto* entry = cache && y < container.max_y() ? cache->insert(key, text) : nullptr) {
+                entry->box = box;
+                entry->box.x -= container.x;
+                entry->box.y -= start_y;
+                entry->end = { .x = x - container.x, .y = y - start_y };
+                entry->lines.reserve(size);
+                for (auto const& l: std::span(lines).subspan(line_start)) {
+                    auto bounds = l.bounds;
+                    bounds.x -= container.x;
+                    bounds.y -= start_y;
+                    entry->lines.push_back({
+                        .offset = static_cast<std::uint32_t>(l.line.data() - text.data()),
+                        .size = static_cast<std::uint32_t>(l.line.size()),
+                        .bounds = bounds
+                    });
+                }
+            }
             return { .container = box, .text_rendered = text.size(), .span = span };
         };
     };
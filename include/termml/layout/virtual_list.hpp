@@ -0,0 +1,149 @@
+#ifndef AMT_TERMML_LAYOUT_VIRTUAL_LIST_HPP
+#define AMT_TERMML_LAYOUT_VIRTUAL_LIST_HPP
+
+#include "../css/style.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace termml::layout {
+    // Heights of the rows of a list with prefix sums over them, kept in a Fenwick tree:
+    // changing a row, the offset of a row and the row at an offset are O(log n).
+    struct RowHeights {
+        // Every row gets `height`.
+        auto assign(std::size_t count, int height) -> void {
+            m_heights.assign(count, height);
+            build();
+        }
+
+        auto assign(std::vector<int> heights) -> void {
+            m_heights = std::move(heights);
+            build();
+        }
+
+        auto set(std::size_t row, int height) -> void {
+            auto const delta = height - m_heights[row];
+            if (delta == 0) return;
+            m_heights[row] = height;
+            m_total += delta;
+            for (auto k = row + 1; k <= m_heights.size(); k += k & (~k + 1)) {
+                m_tree[k] += delta;
+            }
+        }
+
+        constexpr auto height(std::size_t row) const noexcept -> int { return m_heights[row]; }
+
+        // Cells taken up by the rows before `row`.
+        constexpr auto offset(std::size_t row) const noexcept -> int {
+            auto sum = 0;
+            for (auto k = row; k > 0; k &= k - 1) sum += m_tree[k];
+            return sum;
+        }
+
+        // The row that covers `offset` cells from the top; `size()` past the last row.
+        // Rows without height are skipped.
+        constexpr auto row_at(int offset) const noexcept -> std::size_t {
+            if (offset < 0 || m_heights.empty()) return 0;
+            auto row = std::size_t{};
+            for (auto step = std::bit_floor(m_heights.size()); step != 0; step >>= 1) {
+                auto const next = row + step;
+                if (next <= m_heights.size() && m_tree[next] <= offset) {
+                    row = next;
+                    offset -= m_tree[next];
+                }
+            }
+            return row;
+        }
+
+        constexpr auto total() const noexcept -> int { return m_total; }
+        constexpr auto size() const noexcept -> std::size_t { return m_heights.size(); }
+        constexpr auto heights() const noexcept -> std::span<int const> { return m_heights; }
+
+    private:
+        auto build() -> void {
+            m_tree.assign(m_heights.size() + 1, 0);
+            m_total = 0;
+            for (auto k = std::size_t{1}; k <= m_heights.size(); ++k) {
+                m_tree[k] += m_heights[k - 1];
+                m_total += m_heights[k - 1];
+                if (auto parent = k + (k & (~k + 1)); parent <= m_heights.size()) {
+                    m_tree[parent] += m_tree[k];
+                }
+            }
+        }
+
+    private:
+        std::vector<int> m_heights{};
+        // 1-based; `m_tree[k]` sums the `k & -k` rows ending at row `k - 1`.
+        std::vector<int> m_tree{};
+        int m_total{};
+    };
+
+    // What layout keeps for an element with `virtual-rows` between layouts. Its children
+    // are rows: only the ones in view, and `overscan` more on either side, are styled,
+    // sized and laid out, at the offset the heights give them. Rows that were never laid
+    // out count with the estimate.
+    struct VirtualList {
+        static constexpr std::size_t overscan = 4;
+
+        RowHeights heights{};
+        // Layout node of every row the heights are for.
+        std::vector<std::size_t> rows{};
+        // Rows laid out in the last layout, top to bottom.
+        std::vector<std::size_t> laid_out{};
+        // Cells of rows above the list's content box.
+        int scroll{};
+        int estimate{};
+        // What the style and width passes would pass each row.
+        css::Number parent_width{css::Number::fit()};
+        css::Number parent_height{css::Number::fit()};
+        int max_parent_width{};
+        int width_arg{};
+        // The rows may have changed since the heights were matched to them.
+        bool stale{true};
+        // Whether the state belongs to the current layout tree; clean rows of a list that
+        // was not laid out as one have lines from an unrelated layout.
+        bool attached{false};
+
+        // The layout tree was built again: its node indices are new.
+        auto detach() -> void {
+            rows.clear();
+            laid_out.clear();
+            stale = true;
+            attached = false;
+        }
+
+        // Matches the heights to `children`. Rows kept from the last match keep their
+        // height; new ones start at `row_estimate`.
+        auto sync(std::span<std::size_t const> children, int row_estimate) -> void {
+            if (!stale && row_estimate == estimate && rows.size() == children.size()) return;
+            stale = false;
+
+            if (rows.empty() && heights.size() == children.size() && row_estimate == estimate) {
+                // Rebuilt tree over the same rows.
+            } else if (rows.size() <= children.size() && std::ranges::equal(rows, children.first(rows.size()))) {
+                // Rows were appended, as in a log.
+                auto next = std::vector<int>(heights.heights().begin(), heights.heights().end());
+                next.resize(children.size(), row_estimate);
+                heights.assign(std::move(next));
+            } else {
+                auto known = std::unordered_map<std::size_t, int>{};
+                known.reserve(rows.size());
+                for (auto i = std::size_t{}; i < rows.size(); ++i) known.emplace(rows[i], heights.height(i));
+
+                auto next = std::vector<int>(children.size(), row_estimate);
+                for (auto i = std::size_t{}; i < children.size(); ++i) {
+                    if (auto it = known.find(children[i]); it != known.end()) next[i] = it->second;
+                }
+                heights.assign(std::move(next));
+            }
+            rows.assign(children.begin(), children.end());
+            estimate = row_estimate;
+        }
+    };
+} // namespace termml::layout
+
+#endif // AMT_TERMML_LAYOUT_VIRTUAL_LIST_HPP
@@ -0,0 +1,385 @@
+#ifndef AMT_TERMML_XML_BINARY_HPP
+#define AMT_TERMML_XML_BINARY_HPP
+
+#include "node.hpp"
+#include "../core/mapped_file.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Precompiled documents: a parsed and style-resolved `Context` stored as flat,
+// position-independent tables. Loading maps the file and points every string at
+// the mapping, so nothing is lexed, parsed or resolved again.
+//
+// Layout: Header | elements | attributes | children | texts | styles | style sheets | strings.
+// Every section starts at an offset recorded in the header; all references are
+// indices or (offset, size) pairs into the string section.
+namespace termml::xml::binary {
+
+    inline static constexpr std::array<char, 8> magic = { 'T', 'E', 'R', 'M', 'M', 'L', 'B', '\0' };
+    // Bump on any change to the records below or to the layout of `css::Style`.
+    inline static constexpr std::uint32_t version = 3;
+    inline static constexpr std::uint32_t byte_order_mark = 0x01020304;
+    inline static constexpr std::uint32_t null_index = 0xffff'ffff;
+    // Set on a child reference that points at a text node.
+    inline static constexpr std::uint32_t text_child_bit = 0x8000'0000;
+
+    // Styles are stored as raw bytes, so a blob only loads into the build that wrote it.
+    static_assert(std::is_trivially_copyable_v<css::Style>);
+
+    // The layout `version` describes. If one of these fails, update it and bump `version`.
+    static_assert(sizeof(css::Color) == 4);
+    static_assert(sizeof(css::Number) == 8);
+    static_assert(sizeof(css::Border) == 16);
+    static_assert(sizeof(css::QuadProperty) == 32);
+    static_assert(sizeof(css::TextStyle) == 5);
+    static_assert(sizeof(css::Style) == 272);
+    static_assert(offsetof(css::Style, min_width) == 0);
+    static_assert(offsetof(css::Style, width) == 32);
+    static_assert(offsetof(css::Style, display) == 48);
+    static_assert(offsetof(css::Style, border_top) == 56);
+    static_assert(offsetof(css::Style, border_type) == 120);
+    static_assert(offsetof(css::Style, padding) == 136);
+    static_assert(offsetof(css::Style, inset) == 200);
+    static_assert(offsetof(css::Style, z_index) == 232);
+    static_assert(offsetof(css::Style, overflow_x) == 236);
+    static_assert(offsetof(css::Style, virtual_rows) == 244);
+    static_assert(offsetof(css::Style, fg_color) == 248);
+    static_assert(offsetof(css::Style, bg_color) == 252);
+    static_assert(offsetof(css::Style, whitespace) == 256);
+    static_assert(offsetof(css::Style, overflow_wrap) == 260);
+    static_assert(offsetof(css::Style, text_style) == 264);
+
+    struct StringRef {
+        std::uint32_t offset{};
+        std::uint32_t size{};
+    };
+
+    struct Header {
+        std::array<char, 8> magic{};
+        std::uint32_t version{};
+        std::uint32_t byte_order{};
+        std::uint32_t style_size{};
+        std::uint32_t element_count{};
+        std::uint32_t attribute_count{};
+        std::uint32_t child_count{};
+        std::uint32_t text_count{};
+        std::uint32_t style_count{};
+        std::uint32_t string_size{};
+        std::uint32_t style_sheet_count{};
+        std::uint64_t elements{};
+        std::uint64_t attributes{};
+        std::uint64_t children{};
+        std::uint64_t texts{};
+        std::uint64_t styles{};
+        std::uint64_t style_sheets{};
+        std::uint64_t strings{};
+    };
+
+    struct ElementRecord {
+        StringRef tag;
+        std::uint32_t attribute_begin;
+        std::uint32_t attribute_count;
+        std::uint32_t child_begin;
+        std::uint32_t child_count;
+        std::uint32_t style_index;
+        std::uint32_t parent;
+        // `ElementNode::inherits`.
+        std::uint32_t inherits;
+    };
+
+    struct AttributeRecord {
+        StringRef key;
+        StringRef value;
+    };
+
+    struct TextRecord {
+        StringRef text;
+        StringRef normalized_text;
+        StringRef collapsed_text;
+        std::uint32_t style_index;
+        std::uint32_t parent;
+    };
+
+    static_assert(sizeof(Header) == 104);
+    static_assert(sizeof(ElementRecord) == 36);
+    static_assert(sizeof(AttributeRecord) == 16);
+    static_assert(sizeof(TextRecord) == 32);
+
+    namespace detail {
+        inline static constexpr std::size_t section_alignment = 16;
+
+        constexpr auto align(std::size_t n) noexcept -> std::size_t {
+            return (n + section_alignment - 1) & ~(section_alignment - 1);
+        }
+
+        constexpr auto to_u32(std::size_t index) noexcept -> std::uint32_t {
+            return index == invalid_index ? null_index : static_cast<std::uint32_t>(index);
+        }
+
+        constexpr auto from_u32(std::uint32_t index) noexcept -> std::size_t {
+            return index == null_index ? invalid_index : index;
+        }
+
+        struct Writer {
+            std::string buffer{};
+            std::string strings{};
+            std::unordered_map<std::string_view, StringRef> string_cache{};
+
+            // Equal strings share storage; `nullptr` views stay distinguishable from empty ones.
+            auto intern(std::string_view s) -> StringRef {
+                if (s.data() == nullptr) return { .offset = null_index, .size = 0 };
+                if (auto it = string_cache.find(s); it != string_cache.end()) return it->second;
+                auto ref = StringRef{ .offset = static_cast<std::uint32_t>(strings.size()), .size = static_cast<std::uint32_t>(s.size()) };
+                strings.append(s);
+                string_cache.emplace(s, ref);
+                return ref;
+            }
+
+            template <typename T>
+            auto write_section(std::span<T const> items) -> std::uint64_t {
+                buffer.resize(align(buffer.size()));
+                auto offset = buffer.size();
+                buffer.append(reinterpret_cast<char const*>(items.data()), items.size_bytes());
+                return offset;
+            }
+        };
+
+        struct Reader {
+            std::span<std::byte const> bytes;
+            Header header{};
+
+            [[noreturn]] static auto fail(std::string_view what) -> void {
+                throw std::runtime_error(std::format("invalid binary document: {}", what));
+            }
+
+            // Callers check the section bounds first.
+            template <typename T>
+            auto read(std::uint64_t section, std::uint32_t index) const noexcept -> T {
+                auto res = T{};
+                std::memcpy(&res, bytes.data() + section + std::size_t{index} * sizeof(T), sizeof(T));
+                return res;
+            }
+
+            auto check_section(std::uint64_t section, std::uint64_t count, std::size_t size) const -> void {
+                if (section > bytes.size() || count * size > bytes.size() - section) fail("section out of bounds");
+            }
+
+            auto string(StringRef ref) const -> std::string_view {
+                if (ref.offset == null_index) return {};
+                if (std::uint64_t{ref.offset} + ref.size > header.string_size) fail("string out of bounds");
+                return { reinterpret_cast<char const*>(bytes.data() + header.strings + ref.offset), ref.size };
+            }
+        };
+    } // namespace detail
+
+    // Resolves styles if needed and returns the document as a binary blob.
+    inline auto serialize(Context& context) -> std::string {
+        context.resolve_css();
+        auto w = detail::Writer{};
+
+        auto elements = std::vector<ElementRecord>{};
+        auto attributes = std::vector<AttributeRecord>{};
+        auto children = std::vector<std::uint32_t>{};
+        auto texts = std::vector<TextRecord>{};
+        elements.reserve(context.element_nodes.size());
+        texts.reserve(context.text_nodes.size());
+
+        for (auto const& el: context.element_nodes) {
+            auto record = ElementRecord {
+                .tag = w.intern(el.tag),
+                .attribute_begin = static_cast<std::uint32_t>(attributes.size()),
+                .attribute_count = {},
+                .child_begin = static_cast<std::uint32_t>(children.size()),
+                .child_count = static_cast<std::uint32_t>(el.childern.size()),
+                .style_index = detail::to_u32(el.style_index),
+                .parent = detail::to_u32(el.parent),
+                .inherits = el.inherits
+            };
+            for (auto const& [k, v]: el.attributes) {
+                attributes.push_back({ .key = w.intern(k), .value = w.intern(v) });
+            }
+            record.attribute_count = static_cast<std::uint32_t>(attributes.size() - record.attribute_begin);
+            for (auto ch: el.childern) {
+                auto index = static_cast<std::uint32_t>(ch.index);
+                children.push_back(ch.kind == NodeKind::TextContent ? (index | text_child_bit) : index);
+            }
+            elements.push_back(record);
+        }
+
+        for (auto const& t: context.text_nodes) {
+            texts.push_back({
+                .text = w.intern(t.text),
+                .normalized_text = w.intern(t.normalized_text),
+                .collapsed_text = w.intern(t.collapsed_text),
+                .style_index = detail::to_u32(t.style_index),
+                .parent = detail::to_u32(t.parent)
+            });
+        }
+
+        // Kept so restyling a loaded document still applies the rules.
+        auto style_sheets = std::vector<StringRef>{};
+        style_sheets.reserve(context.stylesNodes.size());
+        for (auto const& s: context.stylesNodes) style_sheets.push_back(w.intern(s.text));
+
+        auto header = Header {
+            .magic = magic,
+            .version = version,
+            .byte_order = byte_order_mark,
+            .style_size = sizeof(css::Style),
+            .element_count = static_cast<std::uint32_t>(elements.size()),
+            .attribute_count = static_cast<std::uint32_t>(attributes.size()),
+            .child_count = static_cast<std::uint32_t>(children.size()),
+            .text_count = static_cast<std::uint32_t>(texts.size()),
+            .style_count = static_cast<std::uint32_t>(context.styles.size()),
+            .string_size = static_cast<std::uint32_t>(w.strings.size()),
+            .style_sheet_count = static_cast<std::uint32_t>(style_sheets.size()),
+        };
+
+        w.buffer.resize(sizeof(Header));
+        header.elements = w.write_section(std::span<ElementRecord const>(elements));
+        header.attributes = w.write_section(std::span<AttributeRecord const>(attributes));
+        header.children = w.write_section(std::span<std::uint32_t const>(children));
+        header.texts = w.write_section(std::span<TextRecord const>(texts));
+        header.styles = w.write_section(std::span<css::Style const>(context.styles));
+        header.style_sheets = w.write_section(std::span<StringRef const>(style_sheets));
+        header.strings = w.write_section(std::span<char const>(w.strings));
+        std::memcpy(w.buffer.data(), &header, sizeof(Header));
+        return std::move(w.buffer);
+    }
+
+    inline auto save(Context& context, std::string_view path) -> void {
+        auto blob = serialize(context);
+        auto file = std::ofstream(std::string(path), std::ios::binary);
+        if (!file) {
+            throw std::runtime_error(std::format("unable to open file: {}", path));
+        }
+        file.write(blob.data(), static_cast<std::streamsize>(blob.size()));
+    }
+
+    // Builds a context over `bytes` without copying any strings; `storage` is kept
+    // alive by the context and must own `bytes` unless the caller outlives it.
+    inline auto load(
+        std::span<std::byte const> bytes,
+        std::shared_ptr<void const> storage = {},
+        std::string_view name = "<binary>"
+    ) -> std::unique_ptr<Context> {
+        auto r = detail::Reader{ .bytes = bytes };
+        if (bytes.size() < sizeof(Header)) r.fail("truncated header");
+        std::memcpy(&r.header, bytes.data(), sizeof(Header));
+        auto const& h = r.header;
+        if (h.magic != magic) r.fail("bad magic");
+        if (h.byte_order != byte_order_mark) r.fail("byte order mismatch");
+        if (h.version != version || h.style_size != sizeof(css::Style)) r.fail("written by an incompatible build");
+        if (h.element_count == 0) r.fail("missing root element");
+
+        r.check_section(h.elements, h.element_count, sizeof(ElementRecord));
+        r.check_section(h.attributes, h.attribute_count, sizeof(AttributeRecord));
+        r.check_section(h.children, h.child_count, sizeof(std::uint32_t));
+        r.check_section(h.texts, h.text_count, sizeof(TextRecord));
+        r.check_section(h.styles, h.style_count, sizeof(css::Style));
+        r.check_section(h.style_sheets, h.style_sheet_count, sizeof(StringRef));
+        r.check_section(h.strings, h.string_size, 1);
+
+        auto context = std::make_unique<Context>(Lexer(std::string_view{}, name));
+        context->storage = std::move(storage);
+        auto& c = *context;
+
+        auto check_style = [&](std::uint32_t index) {
+            if (index != null_index && index >= h.style_count) r.fail("style index out of range");
+            return detail::from_u32(index);
+        };
+        auto check_parent = [&](std::uint32_t index) {
+            if (index != null_index && index >= h.element_count) r.fail("parent index out of range");
+            return detail::from_u32(index);
+        };
+
+        c.element_nodes.reserve(h.element_count);
+        for (auto i = 0u; i < h.element_count; ++i) {
+            auto record = r.read<ElementRecord>(h.elements, i);
+            if (std::uint64_t{record.attribute_begin} + record.attribute_count > h.attribute_count) r.fail("attribute range out of bounds");
+            if (std::uint64_t{record.child_begin} + record.child_count > h.child_count) r.fail("child range out of bounds");
+
+            auto el = c.make_element(r.string(record.tag), 0);
+            el.style_index = check_style(record.style_index);
+            el.parent = check_parent(record.parent);
+            el.inherits = record.inherits != 0;
+
+            el.attributes.reserve(record.attribute_count);
+            for (auto j = 0u; j < record.attribute_count; ++j) {
+                auto attr = r.read<AttributeRecord>(h.attributes, record.attribute_begin + j);
+                el.attributes.emplace(r.string(attr.key), r.string(attr.value));
+            }
+
+            el.childern.reserve(record.child_count);
+            for (auto j = 0u; j < record.child_count; ++j) {
+                auto ch = r.read<std::uint32_t>(h.children, record.child_begin + j);
+                auto is_text = (ch & text_child_bit) != 0;
+                auto index = ch & ~text_child_bit;
+                if (index >= (is_text ? h.text_count : h.element_count)) r.fail("child index out of range");
+                el.childern.push_back({ .index = index, .kind = is_text ? NodeKind::TextContent : NodeKind::Element });
+            }
+            c.element_nodes.push_back(std::move(el));
+        }
+
+        c.text_nodes.reserve(h.text_count);
+        for (auto i = 0u; i < h.text_count; ++i) {
+            auto record = r.read<TextRecord>(h.texts, i);
+            c.text_nodes.push_back({
+                .token_index = 0,
+                .text = r.string(record.text),
+                .normalized_text = r.string(record.normalized_text),
+                .style_index = check_style(record.style_index),
+                .parent = check_parent(record.parent),
+                .collapsed_text = r.string(record.collapsed_text)
+            });
+        }
+
+        c.styles.resize(h.style_count);
+        if (h.style_count) std::memcpy(c.styles.data(), bytes.data() + h.styles, std::size_t{h.style_count} * sizeof(css::Style));
+
+        // The styles above already include these rules.
+        for (auto i = 0u; i < h.style_sheet_count; ++i) {
+            auto text = r.string(r.read<StringRef>(h.style_sheets, i));
+            c.stylesNodes.push_back({ .token_index = 0, .text = text });
+            c.stylesheet.append(text);
+        }
+        c.stylesheet_sources = c.stylesNodes.size();
+
+        // Rebuild the lookup indexes in document order.
+        auto stack = std::vector<node_index_t>{ Context::root.index };
+        auto visited = std::size_t{};
+        while (!stack.empty()) {
+            auto node = stack.back();
+            stack.pop_back();
+            if (++visited > h.element_count) r.fail("elements do not form a tree");
+            if (node != Context::root.index) c.index_element(node);
+            auto const& children = c.element_nodes[node].childern;
+            for (auto it = children.rbegin(); it != children.rend(); ++it) {
+                if (it->kind == NodeKind::Element) stack.push_back(it->index);
+            }
+        }
+        return context;
+    }
+
+    inline auto load(std::string_view path) -> std::unique_ptr<Context> {
+        auto file = std::make_shared<core::MappedFile const>(path);
+        auto bytes = file->bytes();
+        return load(bytes, std::move(file), path);
+    }
+
+} // namespace termml::xml::binary
+
+#endif // AMT_TERMML_XML_BINARY_HPP
@@ -0,0 +1,177 @@
+#ifndef AMT_TERMML_XML_BINDINGS_HPP
+#define AMT_TERMML_XML_BINDINGS_HPP
+
+#include "node.hpp"
+#include "../core/string_utils.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace termml::xml {
+
+    // Named `{{placeholder}}`s in the text and authored attribute values of a parsed
+    // document. The document is scanned once; `set` then rewrites only the text nodes
+    // and attributes that use the placeholder and marks them modified, so the next
+    // `resolve_css`/layout only revisits those nodes. Nothing is formatted or parsed on
+    // the update path, and once the buffers have grown no memory is allocated either.
+    //
+    //     auto bindings = xml::Bindings(context.get());
+    //     bindings.set("usage", "95%");
+    //
+    // The bindings keep views into the document and must not outlive it.
+    struct Bindings {
+        static constexpr auto npos = std::numeric_limits<std::size_t>::max();
+
+        explicit Bindings(Context* context)
+            : m_context(context)
+        {
+            auto& c = *m_context;
+            for (auto i = 0ul; i < c.text_nodes.size(); ++i) {
+                add_site({ .index = i, .kind = NodeKind::TextContent }, {}, c.text_nodes[i].text);
+            }
+            for (auto i = 0ul; i < c.element_nodes.size(); ++i) {
+                auto const& el = c.element_nodes[i];
+                for (auto const& [k, v]: el.attributes) add_site({ .index = i, .kind = NodeKind::Element }, k, v);
+            }
+
+            // Placeholders start out empty.
+            for (auto i = 0ul; i < m_sites.size(); ++i) apply(i);
+        }
+
+        Bindings(Bindings const&) = delete;
+        Bindings(Bindings &&) noexcept = default;
+        Bindings& operator=(Bindings const&) = delete;
+        Bindings& operator=(Bindings &&) noexcept = default;
+        ~Bindings() noexcept = default;
+
+        constexpr auto size() const noexcept -> std::size_t {
+            return m_values.size();
+        }
+
+        auto index_of(std::string_view name) const noexcept -> std::size_t {
+            auto it = m_names.find(name);
+            return it == m_names.end() ? npos : it->second;
+        }
+
+        auto contains(std::string_view name) const noexcept -> bool {
+            return index_of(name) != npos;
+        }
+
+        auto get(std::string_view name) const noexcept -> std::string_view {
+            auto index = index_of(name);
+            return index == npos ? std::string_view{} : std::string_view(m_values[index]);
+        }
+
+        // Returns false if the document has no such placeholder.
+        auto set(std::string_view name, std::string_view value) -> bool {
+            auto index = index_of(name);
+            if (index == npos) return false;
+            set(index, value);
+            return true;
+        }
+
+        // Skips the name lookup for callers that resolved `index_of` up front.
+        auto set(std::size_t index, std::string_view value) -> void {
+            auto& current = m_values[index];
+            if (current == value) return;
+            current.assign(value);
+            for (auto site: m_dependents[index]) apply(site);
+        }
+
+    private:
+        struct Segment {
+            // Literal text when `placeholder` is `npos`.
+            std::string_view literal{};
+            std::size_t placeholder{npos};
+        };
+
+        struct Site {
+            Node node;
+            // Empty for text nodes.
+            std::string_view key;
+            std::size_t segment_begin;
+            std::size_t segment_count;
+            // The document keeps a view of one buffer while the other is rewritten, so the
+            // previous value stays intact until the context has dropped it from its indexes.
+            std::array<std::string, 2> buffers{};
+            unsigned active{};
+            bool applied{false};
+        };
+
+        auto placeholder(std::string_view name) -> std::size_t {
+            if (auto it = m_names.find(name); it != m_names.end()) return it->second;
+            auto index = m_values.size();
+            m_names.emplace(name, index);
+            m_values.emplace_back();
+            m_dependents.emplace_back();
+            return index;
+        }
+
+        auto add_site(Node node, std::string_view key, std::string_view text) -> void {
+            if (text.find("{{") == std::string_view::npos) return;
+
+            auto site = m_sites.size();
+            auto begin = m_segments.size();
+            while (!text.empty()) {
+                auto open = text.find("{{");
+                auto close = open == std::string_view::npos ? open : text.find("}}", open + 2);
+                if (close == std::string_view::npos) {
+                    m_segments.push_back({ .literal = text });
+                    break;
+                }
+
+                if (open > 0) m_segments.push_back({ .literal = text.substr(0, open) });
+                auto name = core::utils::trim(text.substr(open + 2, close - open - 2));
+                auto index = placeholder(name);
+                m_segments.push_back({ .placeholder = index });
+                auto& dependents = m_dependents[index];
+                if (dependents.empty() || dependents.back() != site) dependents.push_back(site);
+                text = text.substr(close + 2);
+            }
+
+            m_sites.push_back({
+                .node = node,
+                .key = key,
+                .segment_begin = begin,
+                .segment_count = m_segments.size() - begin
+            });
+        }
+
+        auto apply(std::size_t index) -> void {
+            auto& site = m_sites[index];
+            auto& out = site.buffers[site.active ^ 1];
+            out.clear();
+            for (auto i = site.segment_begin; i < site.segment_begin + site.segment_count; ++i) {
+                auto const& s = m_segments[i];
+                out.append(s.placeholder == npos ? s.literal : std::string_view(m_values[s.placeholder]));
+            }
+
+            if (site.applied && out == site.buffers[site.active]) return;
+            site.applied = true;
+            site.active ^= 1;
+
+            if (site.node.kind == NodeKind::TextContent) {
+                m_context->set_text_view(site.node.index, out);
+            } else {
+                m_context->set_attribute_view(site.node.index, site.key, out);
+            }
+        }
+
+    private:
+        Context* m_context;
+        std::unordered_map<std::string_view, std::size_t> m_names{};
+        std::vector<std::string> m_values{};
+        // Sites that use each placeholder.
+        std::vector<std::vector<std::size_t>> m_dependents{};
+        std::vector<Segment> m_segments{};
+        std::vector<Site> m_sites{};
+    };
+
+} // namespace termml::xml
+
+#endif // AMT_TERMML_XML_BINDINGS_HPP
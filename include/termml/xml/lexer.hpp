@@ -87,48 +87,37 @@ namespace termml::xml {
                 return true;
             }
 
+            // Text, then the name of each reference between its '&' (and '#') and ';'.
             auto offset = start;
-
-            start = 0;
             while (!content.empty()) {
-                auto i = 0u;
-                for (; i < content.size(); ++i) {
-                    auto c = content[i];
-                    if (c == '&') {
-                        if (content.find(';', i + 1) == std::string_view::npos) {
-                            i = static_cast<unsigned>(content.size());
-                        }
-                        break;
-                    }
+                auto amp = content.find('&');
+                // A '&' without a ';' after it is plain text.
+                if (amp != std::string_view::npos && content.find(';', amp + 1) == std::string_view::npos) {
+                    amp = std::string_view::npos;
                 }
-
+                auto const text_size = amp == std::string_view::npos ? content.size() : amp;
                 tokens.push_back({
                     .kind = TokenKind::TextContent,
-                    .start = offset + start,
-                    .end = offset + start + i
+                    .start = offset,
+                    .end = offset + static_cast<unsigned>(text_size)
                 });
+                if (amp == std::string_view::npos) break;
 
-                if (i == content.size()) break;
-                content = content.substr(i);
-                start = i + 1;
-
+                auto name = amp + 1;
                 auto kind = TokenKind::EntityRef;
-
-                if (content[start] == '#') {
-                    ++start;
+                if (content[name] == '#') {
+                    ++name;
                     kind = TokenKind::CharRef;
                 }
 
-                auto end = content.find(';', start);
-                assert(end != std::string_view::npos);
+                auto end = content.find(';', name);
                 tokens.push_back({
                     .kind = kind,
-                    .start = offset + start,
+                    .start = offset + static_cast<unsigned>(name),
                     .end = offset + static_cast<unsigned>(end)
                 });
-                start = static_cast<unsigned>(end) + 1;
-                content = content.substr(start);
-                offset += start;
+                offset += static_cast<unsigned>(end) + 1;
+                content = content.substr(end + 1);
             }
 
             return true;
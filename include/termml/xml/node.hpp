@@ -2,18 +2,34 @@
 #define AMT_TERMML_XML_NODE_HPP
 
 #include "lexer.hpp"
+#include "selector.hpp"
+#include "tag.hpp"
 #include "../core/string_utils.hpp"
 #include "../css/style.hpp"
+#include "../css/stylesheet.hpp"
+#include <algorithm>
+#include <bit>
 #include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <span>
 #include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <string_view>
+#include <utility>
 #include <vector>
 
 namespace termml::xml {
 
     using node_index_t = std::size_t;
+    // Value of `Context::generation` at the time of a mutation.
+    using generation_t = std::uint64_t;
+
+    static constexpr auto invalid_index = std::numeric_limits<std::size_t>::max();
 
     enum class NodeKind {
         Element,
@@ -25,27 +41,68 @@ namespace termml::xml {
         NodeKind kind;
     };
 
+    using attribute_map_t = css::attribute_map_t;
+
+    // A string set through the mutation API, allocated from `Context::string_pool`. The
+    // node reuses it for its next value when that fits.
+    struct StringBuffer {
+        char* data{};
+        std::size_t capacity{};
+    };
+
     struct ElementNode {
         using node_index_t = std::size_t;
         std::string_view tag;
         std::size_t token_index;
-        std::unordered_map<std::string_view, std::string_view> attributes{};
+        TagId tag_id{TagId::Unknown};
+        // Use `Context::make_element` so these allocate from the document arena.
+        attribute_map_t attributes{};
         // Index into global node pool
-        std::vector<Node> childern{};
-        std::size_t style_index{};
+        std::pmr::vector<Node> childern{};
+        std::size_t style_index{invalid_index};
+        // `invalid_index` for the root and for detached nodes.
+        node_index_t parent{invalid_index};
+        // Last change to this element's attributes or children, and last change anywhere
+        // in its subtree including itself.
+        generation_t modified{};
+        generation_t subtree_modified{};
+        // Generation the element's style was last recomputed at.
+        generation_t restyled{};
+        // Generation whitespace collapsing last went through the element's children. Every
+        // restyled or modified element is collapsed again, so layout only revisits these.
+        generation_t collapsed{};
+        // Whether whitespace collapsing had just seen a space before and after this
+        // element in the last pass; see `Context::CollapseState`.
+        std::uint8_t collapse_state{};
+        // Whether a style property of the element, from an attribute or a matched rule, is
+        // "inherit". Such an element can take any of its parent's properties, so it is
+        // restyled whenever the parent is.
+        bool inherits{};
+        // Bumped whenever the element's entries in `Context::tag_index` or
+        // `Context::class_index` go stale; see `Context::IndexEntry`.
+        std::uint32_t tag_version{};
+        std::uint32_t class_version{};
+        // Buffers of the attribute values copied in by `Context::set_attribute`, by key.
+        std::pmr::vector<std::pair<std::string_view, StringBuffer>> value_buffers{};
     };
 
     struct TextContentNode {
         std::size_t token_index;
         std::string_view text;
         std::string_view normalized_text{};
-        std::size_t style_index{};
+        std::size_t style_index{invalid_index};
+        node_index_t parent{invalid_index};
+        // Whitespace-normalized `text`, before trimming against its neighbours. Cached
+        // across incremental resolves; `nullptr` data means it must be recomputed.
+        std::string_view collapsed_text{};
+        // Holds `text` once it is set through `Context::set_text`.
+        StringBuffer buffer{};
     };
 
+    // Text of a `<style>` block; `resolve_css` parses it into `Context::stylesheet`.
     struct StyleNode {
         std::size_t token_index;
         std::string_view text;
-        // TODO: add parsed style nodes
     };
 
     enum class VisitorState {
@@ -55,16 +112,262 @@ namespace termml::xml {
 
     struct Context {
         Lexer lexer;
+        // Keeps externally owned memory that nodes point into alive, such as a mapped
+        // binary document.
+        std::shared_ptr<void const> storage{};
+        // Owns the parsed document: node pools, attributes, child lists and decoded
+        // strings. Nothing is freed individually; it all goes away with the context.
+        std::pmr::monotonic_buffer_resource arena{ initial_arena_size(lexer) };
+        // Owns the strings produced by `resolve_css`; released whenever the whole document
+        // is resolved from scratch.
+        std::pmr::monotonic_buffer_resource computed_arena{};
+        // Owns the values set through the mutation API. A node keeps its buffer for the
+        // next value and returns it here when it no longer fits, so values rewritten every
+        // frame do not grow the document.
+        std::pmr::unsynchronized_pool_resource string_pool{};
+
         static constexpr Node root { .index = 0, .kind = NodeKind::Element };
-        std::vector<ElementNode> element_nodes{};
-        std::vector<TextContentNode> text_nodes{};
-        std::vector<StyleNode> stylesNodes{};
-        std::unordered_map<std::string_view, node_index_t> id_cache{};
+        std::pmr::vector<ElementNode> element_nodes{ &arena };
+        std::pmr::vector<TextContentNode> text_nodes{ &arena };
+        std::pmr::vector<StyleNode> stylesNodes{ &arena };
+        // The indexes copy their keys into the arena, since the values they come from can be
+        // overwritten. Entries are kept once emptied, so each distinct key is copied once;
+        // an id whose element went away maps to `invalid_index`.
+        std::pmr::unordered_map<std::string_view, node_index_t> id_cache{ &arena };
+        // An element in `tag_index` or `class_index`, current while `version` matches the
+        // element's `tag_version` or `class_version`. Detaching an element or changing its
+        // classes bumps the version rather than searching the lists; queries skip stale
+        // entries, and a list drops them before it grows.
+        struct IndexEntry {
+            node_index_t node;
+            std::uint32_t version;
+        };
+        using index_t = std::pmr::unordered_map<std::string_view, std::pmr::vector<IndexEntry>>;
+        using index_version_t = std::uint32_t ElementNode::*;
+        // Attached elements by tag and by class, in the order they were attached.
+        index_t tag_index{ &arena };
+        index_t class_index{ &arena };
+        // Tags and attribute keys passed to the mutation API, copied once each.
+        std::pmr::unordered_set<std::string_view> interned_strings{ &arena };
         std::vector<css::Style> styles{};
+        // Number of nodes using each entry of `styles`; elements with the same tag, style
+        // attributes and parent style share one.
+        std::vector<std::uint32_t> style_refs{};
+        // Entries of `styles` no node uses anymore.
+        std::vector<std::size_t> free_styles{};
+        // Style key to the style parsed for an element in the current pass.
+        struct SharedStyle {
+            std::size_t style_index;
+            node_index_t owner;
+            // The owner's matched rules in `matched_rules`.
+            std::size_t rules_begin;
+            std::size_t rules_count;
+        };
+        // Its nodes come back to the pool when it is cleared, for the next pass to reuse.
+        std::pmr::unsynchronized_pool_resource style_pool{};
+        std::pmr::unordered_map<std::size_t, SharedStyle> style_cache{ &style_pool };
+        // Rules from the `<style>` blocks in `stylesNodes`, and how many of them it holds.
+        css::Stylesheet stylesheet{};
+        std::size_t stylesheet_sources{};
+        // Rules matched by the cached styles' owners, for the current pass.
+        std::vector<std::uint32_t> matched_rules{};
+
+        // Bumped by every mutation. Consumers remember the generation they last saw and
+        // only revisit subtrees whose `subtree_modified` is newer.
+        generation_t generation{};
+        // Generation `styles` were resolved at.
+        generation_t styled_generation{};
+
+        explicit Context(Lexer l)
+            : lexer(std::move(l))
+        {}
+
+        Context(Context const&) = delete;
+        Context& operator=(Context const&) = delete;
+
+        auto make_element(std::string_view tag = {}, std::size_t token_index = 0) -> ElementNode {
+            return {
+                .tag = tag,
+                .token_index = token_index,
+                .tag_id = intern_tag(tag),
+                .attributes = attribute_map_t(&arena),
+                .childern = std::pmr::vector<Node>(&arena),
+                .value_buffers = std::pmr::vector<std::pair<std::string_view, StringBuffer>>(&arena)
+            };
+        }
+
+        // Uninitialized buffer for a decoded string that lives as long as the document.
+        auto allocate_string(std::size_t size) -> char* {
+            return static_cast<char*>(arena.allocate(std::max<std::size_t>(size, 1), alignof(char)));
+        }
+
+        // Copies a caller-owned string into the document arena.
+        auto copy_string(std::string_view s) -> std::string_view {
+            if (s.empty()) return "";
+            auto buffer = allocate_string(s.size());
+            std::memcpy(buffer, s.data(), s.size());
+            return { buffer, s.size() };
+        }
 
-        // unique pointer is used to stablize the string address.
-        std::vector<std::unique_ptr<std::string>> computed_string{};
-        std::vector<std::unique_ptr<std::string>> text_node_computed_string{};
+        // Arena copy of `s`, made on the first call with that string.
+        auto intern(std::string_view s) -> std::string_view {
+            if (auto it = interned_strings.find(s); it != interned_strings.end()) return *it;
+            return *interned_strings.insert(copy_string(s)).first;
+        }
+
+        // ---------------------------- Mutation API ---------------------------------
+        // Values are copied into buffers the node owns and reuses; tags and keys are
+        // interned. New nodes start detached; attach them with `append_child`. Every
+        // mutation marks the changed element and its ancestors, and the next
+        // `resolve_css`/layout only revisits those subtrees.
+
+        auto create_element(std::string_view tag) -> node_index_t {
+            auto index = element_nodes.size();
+            element_nodes.push_back(make_element(intern(tag), lexer.tokens.size()));
+            return index;
+        }
+
+        auto create_text(std::string_view text) -> node_index_t {
+            auto index = text_nodes.size();
+            text_nodes.push_back({ .token_index = lexer.tokens.size(), .text = {} });
+            auto& t = text_nodes.back();
+            t.text = store_string(t.buffer, text);
+            return index;
+        }
+
+        auto set_attribute(node_index_t node, std::string_view key, std::string_view value) -> void {
+            assign_attribute(node, key, value, true);
+        }
+
+        auto remove_attribute(node_index_t node, std::string_view key) -> bool {
+            auto& el = element_nodes[node];
+            auto it = el.attributes.find(key);
+            if (it == el.attributes.end()) return false;
+            if (is_attached(node)) index_attribute(node, it->first, it->second, false);
+            auto buffer = std::ranges::find(el.value_buffers, it->first, &std::pair<std::string_view, StringBuffer>::first);
+            if (buffer != el.value_buffers.end()) {
+                release_string(buffer->second);
+                *buffer = el.value_buffers.back();
+                el.value_buffers.pop_back();
+            }
+            el.attributes.erase(it);
+            mark_modified(node);
+            return true;
+        }
+
+        auto set_text(node_index_t node, std::string_view text) -> void {
+            assign_text(node, text, true);
+        }
+
+        // Variants that keep a view of the caller's string instead of copying it, so values
+        // rewritten every frame do not grow the arena. The string must stay alive and
+        // unchanged until it is replaced by the next call.
+        auto set_attribute_view(node_index_t node, std::string_view key, std::string_view value) -> void {
+            assign_attribute(node, key, value, false);
+        }
+
+        auto set_text_view(node_index_t node, std::string_view text) -> void {
+            assign_text(node, text, false);
+        }
+
+        // Attaches `child` as the last child of `parent`, detaching it first if needed.
+        // Returns false, changing nothing, when `parent` is `child` or inside its subtree.
+        auto append_child(node_index_t parent, Node child) -> bool {
+            if (child.kind == NodeKind::Element) {
+                for (auto p = parent; p != invalid_index; p = element_nodes[p].parent) {
+                    if (p == child.index) return false;
+                }
+            }
+            if (parent_of(child) != invalid_index) remove_child(parent_of(child), child);
+            element_nodes[parent].childern.push_back(child);
+            parent_of(child) = parent;
+            if (child.kind == NodeKind::Element && is_attached(parent)) index_subtree(child.index, true);
+            mark_modified(parent);
+            // Its new parent can change what it inherits.
+            if (child.kind == NodeKind::Element) mark_modified(child.index);
+            return true;
+        }
+
+        // Detaches `child` from `parent`. The node stays in its pool and can be re-attached.
+        auto remove_child(node_index_t parent, Node child) -> bool {
+            auto& children = element_nodes[parent].childern;
+            auto it = std::find_if(children.begin(), children.end(), [child](Node n) {
+                return n.index == child.index && n.kind == child.kind;
+            });
+            if (it == children.end()) return false;
+            if (child.kind == NodeKind::Element && is_attached(parent)) index_subtree(child.index, false);
+            children.erase(it);
+            parent_of(child) = invalid_index;
+            mark_modified(parent);
+            return true;
+        }
+
+        // Forces `node` and its subtree to be restyled and laid out again.
+        auto mark_modified(node_index_t node) -> void {
+            auto g = ++generation;
+            element_nodes[node].modified = g;
+            for (auto i = node; i != invalid_index; i = element_nodes[i].parent) {
+                element_nodes[i].subtree_modified = g;
+            }
+        }
+
+        // Registers an attached element's tag, id and classes; the parser calls this for
+        // every element it keeps.
+        auto index_element(node_index_t node, bool add = true) -> void {
+            auto& el = element_nodes[node];
+            auto const version = ++el.tag_version;
+            if (add) add_to_index(tag_index, &ElementNode::tag_version, el.tag, { .node = node, .version = version });
+            for (auto const& [k, v]: el.attributes) {
+                index_attribute(node, k, v, add);
+            }
+        }
+
+        // ------------------------------ Queries -------------------------------------
+        // The rightmost compound is looked up in the id, class or tag index, and only
+        // those candidates are matched against the rest of the selector. Results come
+        // in index order: document order for parsed nodes, with nodes attached later
+        // after them. Selector lists fall back to a document-order tree walk.
+
+        // First matching element, or `invalid_index`.
+        auto query(Selector const& selector) const -> node_index_t {
+            auto res = invalid_index;
+            for_each_match(selector, [&res](node_index_t n) {
+                res = n;
+                return VisitorState::Break;
+            });
+            return res;
+        }
+
+        auto query(std::string_view selector) const -> node_index_t {
+            return query(Selector::parse(selector));
+        }
+
+        // Appends every matching element to `out`.
+        auto query_all(Selector const& selector, std::vector<node_index_t>& out) const -> void {
+            for_each_match(selector, [&out](node_index_t n) {
+                out.push_back(n);
+                return VisitorState::Continue;
+            });
+        }
+
+        auto query_all(std::string_view selector) const -> std::vector<node_index_t> {
+            auto res = std::vector<node_index_t>{};
+            query_all(Selector::parse(selector), res);
+            return res;
+        }
+
+        auto matches(node_index_t node, Selector const& selector) const -> bool {
+            return std::ranges::any_of(selector.alternatives, [this, node](auto const& complex) {
+                return matches_complex(node, complex);
+            });
+        }
+
+        constexpr auto is_attached(node_index_t node) const noexcept -> bool {
+            for (; node != root.index; node = element_nodes[node].parent) {
+                if (node == invalid_index) return false;
+            }
+            return true;
+        }
 
         auto dump(Node const& node = root, unsigned level = 0) const -> void {
             auto tab = level * 4;
@@ -118,101 +421,548 @@ namespace termml::xml {
 
         template <typename F>
             requires (std::is_invocable_r_v<VisitorState, F, Node>)
-        constexpr auto visit(F&& fn) noexcept -> void {
-            visit_helper(std::forward<F>(fn), Node { .index = 0, .kind = NodeKind::Element });
+        constexpr auto visit(F&& fn) const -> void {
+            auto stack = std::vector<Node>{ root };
+            while (!stack.empty()) {
+                auto node = stack.back();
+                stack.pop_back();
+                if (fn(node) == VisitorState::Break) return;
+                if (node.kind != NodeKind::Element) continue;
+                push_children(stack, node.index, false);
+            }
+        }
+
+        // The first call resolves the whole document. Later calls only restyle elements
+        // modified since, and their descendants when something they inherit changed;
+        // whitespace is re-collapsed only where the restyled elements are. A clean
+        // document does nothing.
+        auto resolve_css() -> void {
+            if (stylesheet_sources < stylesNodes.size()) {
+                for (; stylesheet_sources < stylesNodes.size(); ++stylesheet_sources) {
+                    stylesheet.append(stylesNodes[stylesheet_sources].text);
+                }
+                // New rules can apply anywhere.
+                styles.clear();
+            }
+            if (style_refs.size() != styles.size()) count_style_refs();
+            style_cache.clear();
+            matched_rules.clear();
+            auto& restyled = m_restyled;
+            restyled.clear();
+            if (styles.empty()) {
+                computed_arena.release();
+                free_styles.clear();
+                for (auto& el: element_nodes) el.style_index = invalid_index;
+                for (auto& el: text_nodes) {
+                    el.style_index = invalid_index;
+                    el.collapsed_text = {};
+                }
+                build_style_tree(false, restyled);
+                collapse_whitespace(false);
+                for (auto n: restyled) copy_text_style(n);
+            } else if (element_nodes[root.index].subtree_modified > styled_generation) {
+                build_style_tree(true, restyled);
+                collapse_whitespace(true);
+                for (auto n: restyled) copy_text_style(n);
+            }
+            styled_generation = generation;
         }
 
-        auto resolve_css() {
-            text_node_computed_string.clear();
-            for (auto& el: text_nodes) el.normalized_text = {};
+        // Finishes a document whose element styles were filled in ahead of time, such as
+        // a compiled template: only whitespace collapsing and text styles run.
+        auto resolve_text() -> void {
+            for (auto& el: text_nodes) el.collapsed_text = {};
+            collapse_whitespace(false);
+            fix_text_style(root.index);
+            styled_generation = generation;
+        }
 
-            resolve_css_inheritance();
-            styles.push_back({
-                .width = { .f = 100, .unit = css::Unit::Percentage },
-                .height = { .f = 100, .unit = css::Unit::Percentage },
-            });
-            build_style_tree();
-            collapse_whitespace();
-            fix_text_style();
+        // Indexes every attached element, for documents assembled without `append_child`.
+        auto rebuild_indexes() -> void {
+            id_cache.clear();
+            tag_index.clear();
+            class_index.clear();
+            for (auto c: element_nodes[root.index].childern) {
+                if (c.kind == NodeKind::Element) index_subtree(c.index, true);
+            }
         }
     private:
+        auto assign_attribute(node_index_t node, std::string_view key, std::string_view value, bool copy) -> void {
+            auto& el = element_nodes[node];
+            auto attached = is_attached(node);
+            auto it = el.attributes.find(key);
+            if (it != el.attributes.end()) {
+                if (it->second == value && (copy || it->second.data() == value.data())) return;
+                if (attached) index_attribute(node, it->first, it->second, false);
+            } else {
+                it = el.attributes.emplace(intern(key), std::string_view{}).first;
+            }
+            it->second = copy ? store_string(value_buffer(el, it->first), value) : value;
+            if (attached) index_attribute(node, it->first, it->second, true);
+            mark_modified(node);
+        }
+
+        auto assign_text(node_index_t node, std::string_view text, bool copy) -> void {
+            auto& t = text_nodes[node];
+            if (t.text == text && (copy || t.text.data() == text.data())) return;
+            t.text = copy ? store_string(t.buffer, text) : text;
+            t.collapsed_text = {};
+            if (t.parent != invalid_index) mark_modified(t.parent);
+        }
+
+        auto value_buffer(ElementNode& el, std::string_view key) -> StringBuffer& {
+            for (auto& [k, buffer]: el.value_buffers) {
+                if (k == key) return buffer;
+            }
+            return el.value_buffers.emplace_back(key, StringBuffer{}).second;
+        }
+
+        // Copies `s` into `buffer`, which is replaced by a larger one from `string_pool`
+        // when it does not fit. `s` may be part of the buffer's current value.
+        auto store_string(StringBuffer& buffer, std::string_view s) -> std::string_view {
+            if (s.empty()) return "";
+            if (s.size() <= buffer.capacity) {
+                std::memmove(buffer.data, s.data(), s.size());
+                return { buffer.data, s.size() };
+            }
+            auto capacity = std::bit_ceil(std::max<std::size_t>(s.size(), 16));
+            auto data = static_cast<char*>(string_pool.allocate(capacity, alignof(char)));
+            std::memcpy(data, s.data(), s.size());
+            release_string(buffer);
+            buffer = { .data = data, .capacity = capacity };
+            return { data, s.size() };
+        }
+
+        auto release_string(StringBuffer& buffer) -> void {
+            if (buffer.data) string_pool.deallocate(buffer.data, buffer.capacity, alignof(char));
+            buffer = {};
+        }
+
+        auto parent_of(Node node) noexcept -> node_index_t& {
+            if (node.kind == NodeKind::Element) return element_nodes[node.index].parent;
+            return text_nodes[node.index].parent;
+        }
+
+        // Adds or removes the index entries of a subtree that is being attached to or
+        // detached from the document.
+        auto index_subtree(node_index_t node, bool add) -> void {
+            auto stack = std::vector<Node>{{ .index = node, .kind = NodeKind::Element }};
+            while (!stack.empty()) {
+                auto n = stack.back();
+                stack.pop_back();
+                index_element(n.index, add);
+                push_children(stack, n.index);
+            }
+        }
+
+        auto index_attribute(node_index_t node, std::string_view key, std::string_view value, bool add) -> void {
+            if (key == "id") {
+                auto it = id_cache.find(value);
+                if (add) {
+                    if (it == id_cache.end()) id_cache.emplace(copy_string(value), node);
+                    else it->second = node;
+                } else if (it != id_cache.end() && it->second == node) {
+                    it->second = invalid_index;
+                }
+            } else if (key == "class") {
+                auto const version = ++element_nodes[node].class_version;
+                if (!add) return;
+                for_each_word(value, [this, node, version](std::string_view c) {
+                    add_to_index(class_index, &ElementNode::class_version, c, { .node = node, .version = version });
+                });
+            }
+        }
+
+        // `version` is the element field the index's entries are checked against.
+        auto add_to_index(index_t& index, index_version_t version, std::string_view key, IndexEntry entry) -> void {
+            auto it = index.find(key);
+            if (it == index.end()) it = index.try_emplace(copy_string(key)).first;
+            auto& list = it->second;
+            if (list.size() == list.capacity()) {
+                std::erase_if(list, [this, version](IndexEntry e) { return !is_current(e, version); });
+            }
+            list.push_back(entry);
+        }
+
+        auto is_current(IndexEntry entry, index_version_t version) const noexcept -> bool {
+            return entry.version == element_nodes[entry.node].*version;
+        }
+
         template <typename F>
-            requires (std::is_invocable_r_v<VisitorState, F, Node>)
-        constexpr auto visit_helper(F&& fn, Node const& node) noexcept -> VisitorState {
-            if (node.kind == NodeKind::TextContent) {
-                return fn(element_nodes[node.index]);
-            } else if (node.kind == NodeKind::Element) {
-                auto const& el = element_nodes[node.index];
-                if (fn(el) == VisitorState::Break) return VisitorState::Break;
-                for (auto n: el.childern) {
-                    if (visit_helper(fn, n) == VisitorState::Break) return VisitorState::Break;
+            requires (std::is_invocable_r_v<VisitorState, F, node_index_t>)
+        auto for_each_match(Selector const& selector, F&& fn) const -> void {
+            if (selector.empty()) return;
+
+            if (selector.alternatives.size() > 1) {
+                visit([&](Node n) {
+                    if (n.kind != NodeKind::Element || n.index == root.index) return VisitorState::Continue;
+                    if (!matches(n.index, selector)) return VisitorState::Continue;
+                    return fn(n.index);
+                });
+                return;
+            }
+
+            auto const& complex = selector.alternatives[0];
+            auto const& key = complex.back();
+            if (!key.id.empty()) {
+                if (auto it = id_cache.find(key.id); it != id_cache.end() && it->second != invalid_index && matches_complex(it->second, complex)) {
+                    fn(it->second);
                 }
+                return;
+            }
+
+            auto const* index = &tag_index;
+            auto version = &ElementNode::tag_version;
+            auto index_key = key.tag;
+            if (!key.classes.empty()) {
+                index = &class_index;
+                version = &ElementNode::class_version;
+                index_key = key.classes[0];
+            } else if (key.is_universal()) {
+                visit([&](Node n) {
+                    if (n.kind != NodeKind::Element || n.index == root.index) return VisitorState::Continue;
+                    if (!matches_complex(n.index, complex)) return VisitorState::Continue;
+                    return fn(n.index);
+                });
+                return;
             }
-            return VisitorState::Continue;
+
+            auto it = index->find(index_key);
+            if (it == index->end()) return;
+            for (auto entry: it->second) {
+                if (!is_current(entry, version) || !matches_complex(entry.node, complex)) continue;
+                if (fn(entry.node) == VisitorState::Break) return;
+            }
+        }
+
+        auto find_attribute(ElementNode const& el, std::string_view key) const noexcept -> std::string_view const* {
+            auto it = el.attributes.find(key);
+            if (it == el.attributes.end()) return nullptr;
+            return &it->second;
         }
 
-        auto resolve_css_inheritance(Node const& node = xml::Context::root) -> void {
-            if (node.kind != NodeKind::Element) return;
+        auto matches_compound(node_index_t node, CompoundSelector const& selector) const -> bool {
+            auto const& el = element_nodes[node];
+            if (!selector.is_universal() && el.tag != selector.tag) return false;
 
-            auto& el = element_nodes[node.index];
-            std::vector<std::string_view> to_be_removed;
-            for (auto [k, v]: el.attributes) {
-                if (v == "inherit") {
-                    to_be_removed.push_back(k);
+            if (!selector.id.empty()) {
+                auto id = find_attribute(el, "id");
+                if (!id || *id != selector.id) return false;
+            }
+
+            if (!selector.classes.empty()) {
+                auto classes = find_attribute(el, "class");
+                if (!classes) return false;
+                for (auto c: selector.classes) {
+                    auto word = AttributeSelector{ .name = "class", .value = c, .match = AttributeMatch::Includes };
+                    if (!word.matches(*classes)) return false;
                 }
             }
 
-            for (auto k: to_be_removed) el.attributes.erase(k);
+            for (auto const& attr: selector.attributes) {
+                auto value = find_attribute(el, attr.name);
+                if (!value || !attr.matches(*value)) return false;
+            }
+            return true;
+        }
 
-            for (auto ch: el.childern) {
-                if (ch.kind != NodeKind::Element) continue;
-                auto& child = element_nodes[ch.index];
-                std::unordered_map<std::string_view, std::string_view> tmp; 
-                for (auto [k, v]: child.attributes) {
-                    if (v != "inherit") {
-                        continue;
-                    }
+        // Matches the last compound at `node`, then walks up the ancestors for the rest.
+        // Recursion depth is bounded by the number of compounds in the selector.
+        auto matches_complex(node_index_t node, std::span<CompoundSelector const> complex) const -> bool {
+            if (!matches_compound(node, complex.back())) return false;
+            auto combinator = complex.back().combinator;
+            auto rest = complex.first(complex.size() - 1);
+            if (rest.empty()) return true;
 
-                    if (auto it = el.attributes.find(k); it != child.attributes.end()) {
-                        tmp[k] = it->second;
-                    }
+            for (auto p = element_nodes[node].parent; p != invalid_index && p != root.index; p = element_nodes[p].parent) {
+                if (matches_complex(p, rest)) return true;
+                if (combinator == Combinator::Child) return false;
+            }
+            return false;
+        }
+
+        static auto initial_arena_size(Lexer const& lexer) noexcept -> std::size_t {
+            // Rough estimate of node and attribute storage per source byte; the arena
+            // grows geometrically if the estimate falls short.
+            return std::max<std::size_t>(lexer.source.size() * 4, 1024);
+        }
+
+        // Pushes the children of `node` in reverse so they pop in document order.
+        auto push_children(std::vector<Node>& stack, node_index_t node, bool only_elements = true) const -> void {
+            auto const& el = element_nodes[node];
+            for (auto it = el.childern.rbegin(); it != el.childern.rend(); ++it) {
+                if (only_elements && it->kind != NodeKind::Element) continue;
+                stack.push_back(*it);
+            }
+        }
+
+        // Whether a style property of `el`, from its attributes or the matched `rules`, is
+        // "inherit"; `parse_proprties` resolves it from the parent's computed style.
+        auto uses_inherit(ElementNode const& el, std::span<std::uint32_t const> rules) const -> bool {
+            for (auto const& [k, v]: el.attributes) {
+                if (css::is_inherit(k, v)) return true;
+            }
+            for (auto r: rules) {
+                for (auto const& d: stylesheet.declarations_of(stylesheet.rules[r])) {
+                    if (css::is_inherit(d.key, d.value)) return true;
                 }
+            }
+            return false;
+        }
+
+        // Reuses the node's slot when it already has one.
+        auto style_slot(std::size_t& index) -> css::Style& {
+            if (index >= styles.size()) index = allocate_style();
+            return styles[index];
+        }
+
+        // For styles filled in ahead of time, such as a loaded binary document.
+        auto count_style_refs() -> void {
+            style_refs.assign(styles.size(), 0);
+            free_styles.clear();
+            for (auto const& el: element_nodes) {
+                if (el.style_index < styles.size()) ++style_refs[el.style_index];
+            }
+            for (auto const& t: text_nodes) {
+                if (t.style_index < styles.size()) ++style_refs[t.style_index];
+            }
+            for (auto i = 0ul; i < styles.size(); ++i) {
+                if (style_refs[i] == 0) free_styles.push_back(i);
+            }
+        }
+
+        auto allocate_style() -> std::size_t {
+            if (!free_styles.empty()) {
+                auto index = free_styles.back();
+                free_styles.pop_back();
+                style_refs[index] = 1;
+                return index;
+            }
+            styles.emplace_back();
+            style_refs.push_back(1);
+            return styles.size() - 1;
+        }
+
+        auto release_style(std::size_t index) -> void {
+            if (index >= styles.size()) return;
+            if (--style_refs[index] == 0) free_styles.push_back(index);
+        }
+
+        // Hash of everything `parse_proprties` reads: the tag, the parent's style, the
+        // matched stylesheet rules and the attributes that are style properties. Order
+        // independent, like the attribute map.
+        auto style_key(ElementNode const& el, std::span<std::uint32_t const> rules) const -> std::size_t {
+            auto const parent_style = element_nodes[el.parent].style_index;
+            auto h = std::hash<std::size_t>{}(parent_style) * 31 + static_cast<std::size_t>(el.tag_id);
+            for (auto r: rules) h = h * 31 + r + 1;
+            auto props = std::size_t{};
+            for (auto const& [k, v]: el.attributes) {
+                if (css::property_id(k) == css::PropertyId::Unknown) continue;
+                auto kh = std::hash<std::string_view>{}(k);
+                props += (kh ^ (std::hash<std::string_view>{}(v) + 0x9e3779b97f4a7c15 + (kh << 6) + (kh >> 2)));
+            }
+            return h ^ (props + 0x9e3779b97f4a7c15 + (h << 6) + (h >> 2));
+        }
+
+        auto has_same_style_inputs(
+            ElementNode const& lhs,
+            std::span<std::uint32_t const> lhs_rules,
+            ElementNode const& rhs,
+            std::span<std::uint32_t const> rhs_rules
+        ) const -> bool {
+            if (lhs.tag_id != rhs.tag_id) return false;
+            if (!std::ranges::equal(lhs_rules, rhs_rules)) return false;
+            if (element_nodes[lhs.parent].style_index != element_nodes[rhs.parent].style_index) return false;
+            auto count = [](ElementNode const& el) {
+                return std::ranges::count_if(el.attributes, [](auto const& p) {
+                    return css::property_id(p.first) != css::PropertyId::Unknown;
+                });
+            };
+            if (count(lhs) != count(rhs)) return false;
+            for (auto const& [k, v]: lhs.attributes) {
+                if (css::property_id(k) == css::PropertyId::Unknown) continue;
+                auto it = rhs.attributes.find(k);
+                if (it == rhs.attributes.end() || it->second != v) return false;
+            }
+            return true;
+        }
 
-                if (!tmp.empty()) {
-                    for (auto [k, v]: tmp) child.attributes[k] = v;
+        // Points `node` at the style of an element styled earlier in this pass with the
+        // same inputs, or parses a new one. Tables and lists repeat the same few styles
+        // thousands of times, so most elements end up sharing. `rules` are the matched
+        // stylesheet rules in cascade order; `cascade` is scratch space.
+        auto share_style(
+            node_index_t node,
+            std::span<std::uint32_t const> rules,
+            std::vector<std::pair<std::string_view, std::string_view>>& cascade
+        ) -> void {
+            auto& el = element_nodes[node];
+            release_style(el.style_index);
+
+            auto key = style_key(el, rules);
+            if (auto it = style_cache.find(key); it != style_cache.end()) {
+                auto const& shared = it->second;
+                auto owner_rules = std::span(matched_rules).subspan(shared.rules_begin, shared.rules_count);
+                if (has_same_style_inputs(el, rules, element_nodes[shared.owner], owner_rules)) {
+                    ++style_refs[shared.style_index];
+                    el.style_index = shared.style_index;
+                    return;
                 }
+            }
 
-                for (auto k: css::CSSPropertyKey::inherited_properties) {
-                    if (child.attributes.contains(k)) continue;
-                    if (auto it = el.attributes.find(k); it != child.attributes.end()) {
-                        child.attributes[k] = it->second;
-                    }
+            auto index = allocate_style();
+            auto style = css::Style{};
+            auto const* parent_style = &styles[element_nodes[el.parent].style_index];
+            if (rules.empty()) {
+                style.parse_proprties(el.tag_id, el.attributes, parent_style);
+            } else {
+                // Later entries win, so attributes override rules.
+                cascade.clear();
+                for (auto r: rules) {
+                    for (auto const& d: stylesheet.declarations_of(stylesheet.rules[r])) cascade.emplace_back(d.key, d.value);
                 }
+                cascade.insert(cascade.end(), el.attributes.begin(), el.attributes.end());
+                style.parse_proprties(el.tag_id, cascade, parent_style);
+            }
+            styles[index] = std::move(style);
+            el.style_index = index;
+
+            auto [_, inserted] = style_cache.try_emplace(key, SharedStyle {
+                .style_index = index,
+                .owner = node,
+                .rules_begin = matched_rules.size(),
+                .rules_count = rules.size()
+            });
+            if (inserted) matched_rules.insert(matched_rules.end(), rules.begin(), rules.end());
+        }
 
-                resolve_css_inheritance(ch);
+        // Calls `fn` with the ancestor filter hash of the element's tag, id and classes.
+        template <typename F>
+        auto for_each_filter_hash(ElementNode const& el, F&& fn) const -> void {
+            fn(css::AncestorFilter::hash('<', el.tag));
+            if (auto id = find_attribute(el, "id")) fn(css::AncestorFilter::hash('#', *id));
+            if (auto classes = find_attribute(el, "class")) {
+                for_each_word(*classes, [&fn](std::string_view c) { fn(css::AncestorFilter::hash('.', c)); });
             }
         }
 
-        auto build_style_tree(Node const& node = root) -> void {
-            auto const& el = element_nodes[node.index];
-            for (auto c: el.childern) {
-                if (c.kind == NodeKind::TextContent) {
-                    auto& ch = text_nodes[c.index];
-                    ch.style_index = styles.size();
-                    auto style = css::Style{};
-                    styles.push_back(style);
-                } else if (c.kind == NodeKind::Element) {
-                    auto style = css::Style{};
-                    auto& ch = element_nodes[c.index];
-                    ch.style_index = styles.size();
-                    style.parse_proprties(ch.tag, ch.attributes, &styles[el.style_index]);
-                    styles.push_back(std::move(style));
-                    build_style_tree(c);
+        // Stylesheet rules matching `node`, sorted by specificity and then source order.
+        auto match_rules(node_index_t node, css::AncestorFilter const& filter, std::vector<std::uint32_t>& out) const -> void {
+            out.clear();
+            auto const& el = element_nodes[node];
+            auto id = find_attribute(el, "id");
+            auto classes = find_attribute(el, "class");
+            stylesheet.for_each_candidate(el.tag, id ? *id : std::string_view{}, classes ? *classes : std::string_view{}, [&](std::uint32_t r) {
+                auto const& rule = stylesheet.rules[r];
+                if (filter.may_match(rule) && matches_complex(node, rule.selector)) out.push_back(r);
+            });
+            std::ranges::sort(out, [this](auto a, auto b) {
+                auto const& l = stylesheet.rules[a];
+                auto const& r = stylesheet.rules[b];
+                return l.specificity != r.specificity ? l.specificity < r.specificity : l.order < r.order;
+            });
+            out.erase(std::unique(out.begin(), out.end()), out.end());
+        }
+
+        // What `parse_proprties` takes from the parent's style; children only need to be
+        // restyled when it changes.
+        struct InheritedStyle {
+            css::Display display;
+            css::Color fg_color;
+            css::Color bg_color;
+            css::Whitespace whitespace;
+
+            constexpr auto operator==(InheritedStyle const&) const noexcept -> bool = default;
+        };
+
+        static constexpr auto inherited_style(css::Style const& style) noexcept -> InheritedStyle {
+            return {
+                .display = style.display,
+                .fg_color = style.fg_color,
+                .bg_color = style.bg_color,
+                .whitespace = style.whitespace
+            };
+        }
+
+        // Resolves styles in pre-order, and appends every restyled element to `restyled`.
+        // With `incremental`, only elements modified since the last resolve or missing a
+        // style are restyled; their children follow when an inherited value changed, when
+        // they resolve "inherit" from it, or when stylesheet rules could match them
+        // through it.
+        auto build_style_tree(bool incremental, std::vector<node_index_t>& restyled) -> void {
+            auto& stack = m_style_stack;
+            stack.assign(1, { .node = root.index, .force = !incremental });
+            auto& rules = m_rules;
+            auto& cascade = m_cascade;
+
+            // Elements from the root to the current element's parent, and their hashes.
+            auto const use_stylesheet = !stylesheet.empty();
+            auto& path = m_style_path;
+            path.clear();
+            auto filter = css::AncestorFilter{};
+
+            while (!stack.empty()) {
+                auto const [node, force] = stack.back();
+                stack.pop_back();
+
+                auto& el = element_nodes[node];
+                if (use_stylesheet && el.parent != invalid_index) {
+                    while (!path.empty() && path.back() != el.parent) {
+                        for_each_filter_hash(element_nodes[path.back()], [&filter](auto h) { filter.remove(h); });
+                        path.pop_back();
+                    }
+                }
+
+                auto const modified = el.modified > styled_generation;
+                auto const restyle = force || modified || el.style_index >= styles.size();
+                auto force_children = !incremental;
+                if (restyle) {
+                    auto const had_style = el.style_index < styles.size();
+                    auto const old = had_style ? inherited_style(styles[el.style_index]) : InheritedStyle{};
+
+                    if (el.parent == invalid_index) {
+                        auto& style = style_slot(el.style_index);
+                        style = css::Style{};
+                        style.width = { .f = 100, .unit = css::Unit::Percentage };
+                        style.height = { .f = 100, .unit = css::Unit::Percentage };
+                    } else if (use_stylesheet) {
+                        match_rules(node, filter, rules);
+                        share_style(node, rules, cascade);
+                        el.inherits = uses_inherit(el, rules);
+                    } else {
+                        share_style(node, {}, cascade);
+                        el.inherits = uses_inherit(el, {});
+                    }
+
+                    for (auto c: el.childern) {
+                        if (c.kind == NodeKind::TextContent) style_slot(text_nodes[c.index].style_index) = css::Style{};
+                    }
+                    el.restyled = generation;
+                    restyled.push_back(node);
+
+                    force_children = force_children
+                        || !had_style
+                        || old != inherited_style(styles[el.style_index])
+                        || (modified && stylesheet.has_combinators());
+                }
+
+                if (use_stylesheet && el.parent != invalid_index) {
+                    path.push_back(node);
+                    for_each_filter_hash(el, [&filter](auto h) { filter.add(h); });
+                }
+
+                for (auto it = el.childern.rbegin(); it != el.childern.rend(); ++it) {
+                    if (it->kind != NodeKind::Element) continue;
+                    auto const& ch = element_nodes[it->index];
+                    auto const child_force = force_children || (restyle && ch.inherits);
+                    if (child_force || ch.subtree_modified > styled_generation || ch.style_index >= styles.size()) {
+                        stack.push_back({ .node = it->index, .force = child_force });
+                    }
                 }
             }
         }
 
-        auto normalize_text(std::string_view text, css::Whitespace whitespace, bool& allocated) -> std::string_view {
+        auto normalize_text(std::string_view text, css::Whitespace whitespace) -> std::string_view {
             if (text.empty()) return {};
             if (whitespace == css::Whitespace::Pre || whitespace == css::Whitespace::PreWrap) {
                 return text;
@@ -258,20 +1008,19 @@ namespace termml::xml {
                 return " ";
             }
 
-            text_node_computed_string.push_back(std::make_unique<std::string>());
-            allocated = true;
-            std::string& tmp = *text_node_computed_string.back();
-            tmp.reserve(end - start + 1);
+            // Normalization never grows the text beyond the leading space.
+            auto tmp = static_cast<char*>(computed_arena.allocate(std::max(start, end) - start + 1, alignof(char)));
+            auto size = std::size_t{};
 
             // Keep leading and trailing whitespaces
             if (start > 0) {
-                tmp.push_back(' ');
+                tmp[size++] = ' ';
             }
 
             for (auto i = start; i < end;) {
                 auto c = text[i];
                 if ((c == '\n') && whitespace == css::Whitespace::PreLine) {
-                    tmp.push_back(text[i]);
+                    tmp[size++] = text[i];
                     ++i;
                     continue;
                 }
@@ -280,36 +1029,66 @@ namespace termml::xml {
                     continue;
                 }
                 if (std::isspace(c)) {
-                    tmp.push_back(' ');
+                    tmp[size++] = ' ';
                     while (i < end && std::isspace(text[i])) {
                         ++i;
                     }
                     continue;
                 }
-                tmp.push_back(text[i]);
+                tmp[size++] = text[i];
                 ++i;
             }
 
-            return tmp;
+            return { tmp, size };
         }
 
-        auto collapse_whitespace(
-            Node const& node = root,
-            css::Display context = css::Display::Block,
-            bool last_char_was_whitespace = true,
-            bool has_right_padding = false
-        ) -> bool {
+        // State of an element whose inline children are being collapsed.
+        struct CollapseFrame {
+            node_index_t node_index;
+            std::size_t child{};
+            css::Display context{css::Display::Block};
+            bool has_right_padding{false};
+        };
+
+        // Bits of `ElementNode::collapse_state`.
+        enum CollapseState: std::uint8_t {
+            CollapseKnown = 1,
+            WhitespaceBefore = 2,
+            WhitespaceAfter = 4
+        };
+
+        // An element's texts only depend on its subtree's styles and on whether a space
+        // came right before it, so with `incremental` unchanged elements whose incoming
+        // state matches the last pass are skipped.
+        auto collapse_whitespace(bool incremental) -> void {
             using namespace css;
-            auto const& el = element_nodes[node.index];
+            auto& stack = m_collapse_stack;
+            stack.assign(1, { .node_index = root.index });
+            element_nodes[root.index].collapsed = generation;
+            // Threaded through the whole document in order.
+            auto last_char_was_whitespace = true;
+
+            while (!stack.empty()) {
+                auto& frame = stack.back();
+                auto& el = element_nodes[frame.node_index];
+                if (frame.child >= el.childern.size()) {
+                    if (last_char_was_whitespace) el.collapse_state |= WhitespaceAfter;
+                    stack.pop_back();
+                    continue;
+                }
+
+                auto const c = el.childern[frame.child++];
+                auto const context = frame.context;
+                auto const has_right_padding = frame.has_right_padding;
 
-            for (auto i = 0ul; i < el.childern.size(); ++i) {
-                auto const& c = el.childern[i];
                 if (c.kind == NodeKind::TextContent) {
                     auto& ch = text_nodes[c.index];
                     auto& style = styles[ch.style_index];
-                    auto txt = ch.text;
-                    bool allocated{false};
-                    txt = normalize_text(txt, style.whitespace, allocated);
+                    ch.normalized_text = {};
+                    if (ch.collapsed_text.data() == nullptr) {
+                        ch.collapsed_text = normalize_text(ch.text, style.whitespace);
+                    }
+                    auto txt = ch.collapsed_text;
 
                     std::string_view pattern = " \n\t\r\f\v";
                     if (style.whitespace == css::Whitespace::PreLine) {
@@ -322,7 +1101,6 @@ namespace termml::xml {
                         style.display = Display::Block;
 
                         if (core::utils::trim(txt).empty()) {
-                            if (allocated) text_node_computed_string.pop_back();
                             ch.normalized_text = {};
                             continue;
                         }
@@ -347,35 +1125,73 @@ namespace termml::xml {
 
                 } else if (c.kind == NodeKind::Element) {
                     auto& ch = element_nodes[c.index];
+                    if (incremental && is_collapsed(ch, last_char_was_whitespace)) {
+                        last_char_was_whitespace = ch.collapse_state & WhitespaceAfter;
+                        continue;
+                    }
+
+                    ch.collapse_state = CollapseKnown | (last_char_was_whitespace ? WhitespaceBefore : 0);
+                    ch.collapsed = generation;
                     auto& style = styles[ch.style_index];
                     last_char_was_whitespace |= style.has_start_whitespace();
-                    last_char_was_whitespace = collapse_whitespace(c, style.display, last_char_was_whitespace, style.has_end_whitespace());
+                    stack.push_back({
+                        .node_index = c.index,
+                        .context = style.display,
+                        .has_right_padding = style.has_end_whitespace()
+                    });
                 }
             }
+        }
 
-            return last_char_was_whitespace;
+        // Whether the last pass left `el`'s subtree as this one would.
+        constexpr auto is_collapsed(ElementNode const& el, bool whitespace_before) const noexcept -> bool {
+            if (!(el.collapse_state & CollapseKnown)) return false;
+            if (bool(el.collapse_state & WhitespaceBefore) != whitespace_before) return false;
+            // Restyled descendants are covered: their parent was restyled or modified too.
+            return el.subtree_modified <= styled_generation && el.restyled != generation;
         }
 
-        constexpr auto fix_text_style(Node const& node = root) noexcept -> void {
-            using namespace css;
-            auto const& el = element_nodes[node.index];
+        // Copies the properties texts take from their element.
+        constexpr auto copy_text_style(node_index_t node) -> void {
+            auto const& el = element_nodes[node];
             auto const& style = styles[el.style_index];
-
             for (auto c: el.childern) {
-                if (c.kind == NodeKind::TextContent) {
-                    auto& ch = text_nodes[c.index];
-                    auto& tmp_style = styles[ch.style_index];
-                    tmp_style.fg_color = style.fg_color;
-                    tmp_style.bg_color = style.bg_color;
-                    tmp_style.z_index = style.z_index;
-                    tmp_style.overflow_wrap = style.overflow_wrap;
-                    tmp_style.whitespace = style.whitespace;
-                    tmp_style.text_style = style.text_style;
-                } else if (c.kind == NodeKind::Element) {
-                    fix_text_style(c);
-                }
+                if (c.kind != NodeKind::TextContent) continue;
+                auto& tmp_style = styles[text_nodes[c.index].style_index];
+                tmp_style.fg_color = style.fg_color;
+                tmp_style.bg_color = style.bg_color;
+                tmp_style.z_index = style.z_index;
+                tmp_style.overflow_wrap = style.overflow_wrap;
+                tmp_style.whitespace = style.whitespace;
+                tmp_style.text_style = style.text_style;
             }
         }
+
+        constexpr auto fix_text_style(node_index_t start) -> void {
+            auto stack = std::vector<Node>{{ .index = start, .kind = NodeKind::Element }};
+
+            while (!stack.empty()) {
+                auto node = stack.back();
+                stack.pop_back();
+                copy_text_style(node.index);
+                push_children(stack, node.index);
+            }
+        }
+
+        // An element `build_style_tree` is going to visit.
+        struct StyleFrame {
+            node_index_t node;
+            bool force;
+        };
+
+        // Scratch space of `resolve_css`, kept so that restyling a few elements does not
+        // allocate.
+        std::vector<node_index_t> m_restyled{};
+        std::vector<StyleFrame> m_style_stack{};
+        std::vector<std::uint32_t> m_rules{};
+        std::vector<std::pair<std::string_view, std::string_view>> m_cascade{};
+        std::vector<node_index_t> m_style_path{};
+        std::vector<CollapseFrame> m_collapse_stack{};
     };
 
 } // namespace termml::xml
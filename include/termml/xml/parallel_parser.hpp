@@ -0,0 +1,237 @@
+#ifndef AMT_TERMML_XML_PARALLEL_PARSER_HPP
+#define AMT_TERMML_XML_PARALLEL_PARSER_HPP
+
+#include "lexer.hpp"
+#include "node.hpp"
+#include "parser.hpp"
+#include "../core/string_utils.hpp"
+#include "../core/thread_pool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace termml::xml {
+
+    struct ParallelParseOptions {
+        // 0 uses every hardware thread.
+        std::size_t threads{0};
+        // Documents are not split into segments smaller than this.
+        std::size_t min_segment_size{256 * 1024};
+        // Segments per thread, so threads that finish early pick up more work.
+        std::size_t segments_per_thread{4};
+    };
+
+    namespace detail {
+
+        // Offsets of top-level start tags that split `source` into roughly `count` equal
+        // segments. Only tags, quoted attribute values and comments are looked at.
+        inline auto find_split_points(std::string_view source, std::size_t count) -> std::vector<std::size_t> {
+            auto res = std::vector<std::size_t>{};
+            if (count < 2) return res;
+            res.reserve(count - 1);
+
+            auto const step = source.size() / count;
+            auto next = step;
+            auto depth = std::size_t{};
+            auto i = source.find('<');
+
+            while (i < source.size()) {
+                auto rest = source.substr(i);
+                if (rest.starts_with("<!--")) {
+                    auto end = source.find("-->", i + 4);
+                    i = end == std::string_view::npos ? source.size() : source.find('<', end + 3);
+                    continue;
+                }
+
+                auto is_end_tag = rest.starts_with("</");
+                if (!is_end_tag && depth == 0 && i >= next && i > 0) {
+                    res.push_back(i);
+                    if (res.size() + 1 == count) break;
+                    next = std::max(next + step, i + 1);
+                }
+
+                // Find the '>' closing the tag, skipping quoted values.
+                auto j = i + 1;
+                for (; j < source.size() && source[j] != '>'; ++j) {
+                    if (is_end_tag || source[j] != '"') continue;
+                    for (++j; j < source.size() && source[j] != '"'; ++j) {
+                        if (source[j] == '\\') ++j;
+                    }
+                }
+                if (j >= source.size()) break;
+
+                if (is_end_tag) {
+                    // Unmatched end tags at the top level are skipped by the parser.
+                    if (depth > 0) --depth;
+                } else if (source[j - 1] != '/') {
+                    ++depth;
+                }
+                i = source.find('<', j + 1);
+            }
+            return res;
+        }
+
+        // Whitespace after the last '>' of a segment. The sequential lexer keeps it as a
+        // text node, but a segment lexer drops it as trailing whitespace.
+        inline auto trailing_whitespace(std::string_view segment) noexcept -> std::string_view {
+            auto close = segment.rfind('>');
+            if (close == std::string_view::npos || close == 0 || segment[close - 1] == '/') return {};
+            auto tail = segment.substr(close + 1);
+            if (tail.empty() || !core::utils::trim(tail).empty()) return {};
+            return tail;
+        }
+
+        // Moves the nodes of `segment` into `out`, rebasing every index. The nodes keep
+        // pointing into the segment's source and arena, so `segment` must outlive `out`.
+        // `out` should have room for all segments up front: growing the node pools copies
+        // every element's attribute map.
+        inline auto append_segment(Context& out, Context& segment) -> void {
+            // Segment element `i` becomes `i + element_offset`; its root maps to the root.
+            auto const element_offset = out.element_nodes.size() - 1;
+            auto const text_offset = out.text_nodes.size();
+            auto rebase_element = [element_offset](node_index_t i) {
+                return (i == Context::root.index || i == invalid_index) ? i : i + element_offset;
+            };
+            auto rebase = [&](Node n) -> Node {
+                if (n.kind == NodeKind::Element) return { .index = rebase_element(n.index), .kind = n.kind };
+                return { .index = n.index + text_offset, .kind = n.kind };
+            };
+
+            auto& root = out.element_nodes[Context::root.index];
+            for (auto c: segment.element_nodes[Context::root.index].childern) {
+                root.childern.push_back(rebase(c));
+            }
+
+            for (auto i = 1ul; i < segment.element_nodes.size(); ++i) {
+                auto& el = segment.element_nodes[i];
+                el.parent = rebase_element(el.parent);
+                for (auto& c: el.childern) c = rebase(c);
+                out.element_nodes.push_back(std::move(el));
+            }
+
+            for (auto& t: segment.text_nodes) {
+                t.parent = rebase_element(t.parent);
+                out.text_nodes.push_back(t);
+            }
+
+            out.stylesNodes.insert(out.stylesNodes.end(), segment.stylesNodes.begin(), segment.stylesNodes.end());
+
+            // Later segments come later in the document, so their ids win like they do
+            // when parsing sequentially.
+            for (auto const& [k, v]: segment.id_cache) out.id_cache[k] = rebase_element(v);
+            auto merge = [&](Context::index_t& to, Context::index_t const& from) {
+                for (auto const& [k, nodes]: from) {
+                    auto& list = to[k];
+                    for (auto e: nodes) list.push_back({ .node = rebase_element(e.node), .version = e.version });
+                }
+            };
+            merge(out.tag_index, segment.tag_index);
+            merge(out.class_index, segment.class_index);
+        }
+
+        // Threads shared by the calls to `parse_parallel` that do not bring their own.
+        inline auto parse_pool() -> core::ThreadPool& {
+            static auto pool = core::ThreadPool{};
+            return pool;
+        }
+
+    } // namespace detail
+
+    // Lexes and parses a large document on the threads of `pool`. The source is split
+    // between top-level elements, every segment gets its own lexer and parser, and the
+    // results are stitched into one context that is equivalent to a sequential parse.
+    // Small documents are parsed sequentially.
+    inline auto parse_parallel(core::ThreadPool& pool, Lexer&& lexer, ParallelParseOptions options = {}) -> std::unique_ptr<Context> {
+        auto threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        auto max_segments = lexer.source.size() / std::max<std::size_t>(options.min_segment_size, 1);
+        auto segments = std::min(threads * std::max<std::size_t>(options.segments_per_thread, 1), max_segments);
+
+        auto splits = detail::find_split_points(lexer.source, segments);
+        if (threads < 2 || splits.empty()) {
+            lexer.lex();
+            auto parser = Parser(std::move(lexer));
+            parser.parse();
+            return std::move(parser.context);
+        }
+
+        auto source = std::string_view(lexer.source);
+        splits.insert(splits.begin(), 0);
+        splits.push_back(source.size());
+        auto const count = splits.size() - 1;
+
+        using segments_t = std::vector<std::unique_ptr<Context>>;
+        auto parsed = std::make_shared<segments_t>(count);
+        auto errors = std::vector<std::exception_ptr>(count);
+        auto next = std::atomic<std::size_t>{};
+
+        pool.run(std::min(threads, count), [&](std::size_t) {
+            for (auto i = next++; i < count; i = next++) {
+                try {
+                    auto l = Lexer(source.substr(splits[i], splits[i + 1] - splits[i]), lexer.path);
+                    l.lex();
+                    auto parser = Parser(std::move(l));
+                    parser.parse();
+                    (*parsed)[i] = std::move(parser.context);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        });
+
+        for (auto const& e: errors) {
+            if (e) std::rethrow_exception(e);
+        }
+
+        auto context = std::make_unique<Context>(Lexer(std::string_view{}, lexer.path));
+        auto elements = std::size_t{1};
+        auto texts = count;
+        auto ids = std::size_t{};
+        for (auto const& segment: *parsed) {
+            elements += segment->element_nodes.size() - 1;
+            texts += segment->text_nodes.size();
+            ids += segment->id_cache.size();
+        }
+        context->element_nodes.reserve(elements);
+        context->text_nodes.reserve(texts);
+        context->id_cache.reserve(ids);
+
+        context->element_nodes.push_back(context->make_element("#root"));
+        for (auto i = 0ul; i < count; ++i) {
+            auto& segment = *(*parsed)[i];
+            detail::append_segment(*context, segment);
+            // Nothing refers to the tokens once the nodes are parsed; the source stays,
+            // since the nodes view it.
+            segment.lexer.tokens = {};
+
+            if (i + 1 == count) continue;
+            if (auto ws = detail::trailing_whitespace(segment.lexer.source); !ws.empty()) {
+                auto index = context->text_nodes.size();
+                context->text_nodes.push_back({ .token_index = 0, .text = ws, .parent = Context::root.index });
+                context->element_nodes[Context::root.index].childern.push_back({ .index = index, .kind = NodeKind::TextContent });
+            }
+        }
+
+        // The nodes point into the segments' sources and arenas.
+        context->storage = std::move(parsed);
+        return context;
+    }
+
+    inline auto parse_parallel(Lexer&& lexer, ParallelParseOptions options = {}) -> std::unique_ptr<Context> {
+        return parse_parallel(detail::parse_pool(), std::move(lexer), options);
+    }
+
+    inline auto parse_parallel(core::ThreadPool& pool, std::string_view path, ParallelParseOptions options = {}) -> std::unique_ptr<Context> {
+        return parse_parallel(pool, Lexer(path), options);
+    }
+
+    inline auto parse_parallel(std::string_view path, ParallelParseOptions options = {}) -> std::unique_ptr<Context> {
+        return parse_parallel(Lexer(path), options);
+    }
+
+} // namespace termml::xml
+
+#endif // AMT_TERMML_XML_PARALLEL_PARSER_HPP
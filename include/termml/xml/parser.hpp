@@ -5,9 +5,11 @@
 #include "termml/core/string_utils.hpp"
 #include "termml/xml/token.hpp"
 #include <cassert>
+#include <cstring>
 #include <memory>
 #include <print>
 #include <unordered_map>
+#include <vector>
 
 namespace termml::xml {
 
@@ -17,10 +19,7 @@ namespace termml::xml {
         Parser(Lexer&& lexer) noexcept
             : context(std::make_unique<Context>(std::move(lexer)))
         {
-            context->element_nodes.push_back({
-                .tag = "#root",
-                .token_index = lexer.tokens.size()
-            });
+            context->element_nodes.push_back(context->make_element("#root", lexer.tokens.size()));
         }
 
         auto parse() -> void {
@@ -46,44 +45,53 @@ namespace termml::xml {
             return context->lexer.tokens[m_index];
         }
 
+        // Trimmed and unescaped attribute value.
         auto compute_string(std::string_view s) -> std::string_view {
             auto text = core::utils::trim(s);
-            auto has_escape = s.find('\\') != std::string_view::npos;
-            if (has_escape) {
-                std::string tmp;
-                tmp.reserve(text.size() + 8);
-                for (auto i = 0ul; i < s.size(); ++i) {
-                    auto c = s[i];
-                    if (c != '\\') {
-                        tmp.push_back(c);
-                        continue;
-                    }
-                    if (i + 1 >= s.size()) break;
-
-                    c = s[i + 1];
-                    switch (c) {
-                        case 'n': tmp.push_back('\n'); break;
-                        case 'r': tmp.push_back('\r'); break;
-                        case 't': tmp.push_back('\t'); break;
-                        case 'b': tmp.push_back('\b'); break;
-                        case 'f': tmp.push_back('\f'); break;
-                        case 'v': tmp.push_back('\v'); break;
-                        case '\\': tmp.push_back('\\'); break;
-                        case '\'': tmp.push_back('\''); break;
-                        case '"': tmp.push_back('"'); break;
-                    }
-                }
+            if (!text.contains('\\')) return text;
+            return decode(text, [](std::string_view in, auto&& out) { core::utils::unescape(in, out); });
+        }
 
-                context->computed_string.push_back(std::make_unique<std::string>(std::move(tmp)));
-                text = *context->computed_string.back();
+        // The lexer splits text around character references; joins the run starting at the
+        // current token into one decoded string and moves past it.
+        auto parse_text() -> std::string_view {
+            auto const& tokens = context->lexer.tokens;
+            auto const start = current_token().start;
+            auto end = current_token().end;
+            auto has_reference = false;
+            for (++m_index; !empty(); ++m_index) {
+                auto const& token = tokens[m_index];
+                if (token.is(TokenKind::TextContent)) {
+                    end = token.end;
+                } else if (token.is(TokenKind::EntityRef, TokenKind::CharRef)) {
+                    // Up to and including the ';'.
+                    end = token.end + 1;
+                    has_reference = true;
+                } else {
+                    break;
+                }
             }
-            return text;
+
+            auto text = std::string_view(context->lexer.source).substr(start, end - start);
+            if (!has_reference) return text;
+            return decode(text, [](std::string_view in, auto&& out) { core::utils::decode_references(in, out); });
         }
 
-        static constexpr auto can_have_children(std::string_view tag) noexcept -> bool {
-            if (tag == "br") return false;
-            if (tag == "img") return false;
-            return true;
+        // Runs one of the decoders of `core::utils` into the arena. Both only ever shrink
+        // the string.
+        template <typename Decoder>
+        auto decode(std::string_view s, Decoder&& decoder) -> std::string_view {
+            auto buffer = context->allocate_string(s.size());
+            auto size = std::size_t{};
+            decoder(s, [buffer, &size](std::string_view piece) {
+                std::memcpy(buffer + size, piece.data(), piece.size());
+                size += piece.size();
+            });
+            return { buffer, size };
+        }
+
+        static constexpr auto can_have_children(TagId tag) noexcept -> bool {
+            return !is_void_tag(tag);
         }
 
         auto parse_start_tag(node_index_t node_index) -> bool {
@@ -95,10 +103,9 @@ namespace termml::xml {
 
             auto tag_text = token.text(context->lexer.source);
             auto& node = context->element_nodes[node_index];
-            node = ElementNode {
-                .tag = tag_text,
-                .token_index = m_index
-            };
+            node.tag = tag_text;
+            node.tag_id = intern_tag(tag_text);
+            node.token_index = m_index;
 
             auto current = m_index + 1;
             find_next(TokenKind::CloseTag, TokenKind::EmptyCloseTag);
@@ -126,9 +133,6 @@ namespace termml::xml {
 
                         if (context->lexer.tokens[current].is(TokenKind::String)) {
                             node.attributes[attribute] = compute_string(context->lexer.tokens[current].text(context->lexer.source));
-                            if (attribute == "id") {
-                                context->id_cache[node.attributes[attribute]] = node_index;
-                            }
                             ++current;
                         }
                     }
@@ -159,72 +163,123 @@ namespace termml::xml {
             return true;
         }
 
-        auto parse_element(node_index_t root_index, bool insert_children = true) -> void {
-            if (empty()) return;
-            if (current_token().is(TokenKind::Eof)) return;
+        // Parsing state of an element whose children are still being consumed.
+        struct ParseFrame {
+            node_index_t node_index;
+            // Children are dropped for void elements like "<br>".
+            bool insert_children{true};
+            // Element itself is dropped if its parent cannot have children.
+            bool is_inserted{true};
+            // "<style>" keeps its text as a stylesheet and is dropped from the tree.
+            bool is_style{false};
+        };
 
-            auto token = current_token();
+        auto open_element(node_index_t parent_index) -> bool {
+            auto const& parent_frame = m_stack.back();
+            auto node_index = context->element_nodes.size();
+            context->element_nodes[parent_index].childern.push_back({
+                .index = node_index,
+                .kind = NodeKind::Element
+            });
 
-            auto& root = context->element_nodes[root_index];
-            if (token.is(TokenKind::TextContent)) {
-                auto text = current_token().text(context->lexer.source);
+            context->element_nodes.push_back(context->make_element());
+            context->element_nodes.back().parent = parent_index;
 
-                if (insert_children) {
-                    root.childern.push_back({
-                        .index = context->text_nodes.size(),
-                        .kind = NodeKind::TextContent
-                    });
+            auto is_valid = parse_start_tag(node_index);
+            if (!is_valid) return false;
+            if (empty()) return false;
 
-                    context->text_nodes.push_back({
-                        .token_index = m_index,
-                        .text = text
-                    });
-                }
+            auto tag_id = context->element_nodes[node_index].tag_id;
+            auto is_style = tag_id == TagId::Style && parent_frame.insert_children;
+            auto frame = ParseFrame {
+                .node_index = node_index,
+                .insert_children = can_have_children(tag_id) && !is_style,
+                .is_inserted = parent_frame.insert_children && !is_style,
+                .is_style = is_style
+            };
+            if (frame.is_inserted) context->index_element(node_index);
 
-                ++m_index;
-            } else if (token.is(TokenKind::StartOpenTag)) {
-                auto node_index = context->element_nodes.size();
-                auto old_root_size = root.childern.size();
-                root.childern.push_back({
-                    .index = node_index,
-                    .kind = NodeKind::Element
-                });
+            if (current_token().is(TokenKind::EmptyCloseTag)) {
+                close_element(frame, parent_index);
+                return true;
+            }
 
-                context->element_nodes.emplace_back();
+            ++m_index;
+            m_stack.push_back(frame);
+            return true;
+        }
 
-                auto is_valid = parse_start_tag(node_index);
-                if (!is_valid) return;
+        auto close_element(ParseFrame const& frame, node_index_t parent_index) -> void {
+            auto tag = context->element_nodes[frame.node_index].tag;
+            if (!frame.is_inserted) {
+                context->element_nodes.resize(frame.node_index);
+                context->element_nodes[parent_index].childern.pop_back();
+            }
 
-                auto& node = context->element_nodes[node_index];
-                auto tag = node.tag;
+            parse_end_tag(tag);
+        }
 
-                if (empty()) return;
-                if (!current_token().is(TokenKind::EmptyCloseTag)) {
-                    ++m_index;
-                    auto have_children = can_have_children(tag);
-                    while (!empty() && !current_token().is(TokenKind::EndOpenTag, TokenKind::Eof)) {
-                        parse_element(node_index, have_children);
+        auto parse_helper(node_index_t root_index) -> void {
+            m_stack.clear();
+            m_stack.push_back({ .node_index = root_index });
+
+            while (!empty()) {
+                auto token = current_token();
+                if (token.is(TokenKind::Eof)) break;
+
+                auto parent_index = m_stack.back().node_index;
+                if (token.is(TokenKind::TextContent)) {
+                    auto const token_index = m_index;
+                    if (m_stack.back().is_style) {
+                        context->stylesNodes.push_back({
+                            .token_index = token_index,
+                            .text = token.text(context->lexer.source)
+                        });
+                        ++m_index;
+                    } else {
+                        auto text = parse_text();
+                        if (m_stack.back().insert_children) {
+                            context->element_nodes[parent_index].childern.push_back({
+                                .index = context->text_nodes.size(),
+                                .kind = NodeKind::TextContent
+                            });
+
+                            context->text_nodes.push_back({
+                                .token_index = token_index,
+                                .text = text,
+                                .parent = parent_index
+                            });
+                        }
+                    }
+                } else if (token.is(TokenKind::StartOpenTag)) {
+                    if (!open_element(parent_index)) break;
+                } else if (token.is(TokenKind::EndOpenTag)) {
+                    if (m_stack.size() == 1) {
+                        // unmatched end tag at the top level
+                        find_next(TokenKind::CloseTag);
+                        ++m_index;
+                        continue;
                     }
-                }
 
-                if (!insert_children) {
-                    context->element_nodes.resize(node_index);
-                    root.childern.resize(old_root_size);
-                    root.childern.pop_back();
+                    auto frame = m_stack.back();
+                    m_stack.pop_back();
+                    close_element(frame, m_stack.back().node_index);
+                } else {
+                    // Comments are not part of the tree yet.
+                    ++m_index;
                 }
-
-                parse_end_tag(tag);
             }
-        }
 
-        auto parse_helper(node_index_t root_index) -> void {
-            while (!empty()) {
-                if (current_token().is(TokenKind::Eof)) return;
-                parse_element(root_index);
+            // Unclosed elements at the end of the document.
+            while (m_stack.size() > 1) {
+                auto frame = m_stack.back();
+                m_stack.pop_back();
+                close_element(frame, m_stack.back().node_index);
             }
         }
     private:
         std::size_t m_index{};
+        std::vector<ParseFrame> m_stack{};
     }; 
 
 } // namespace termml::xml
@@ -0,0 +1,18 @@
+#ifndef AMT_TERMML_XML_SELECTOR_HPP
+#define AMT_TERMML_XML_SELECTOR_HPP
+
+#include "../css/selector.hpp"
+
+namespace termml::xml {
+
+    // Selectors are parsed by css, for stylesheets and for `Context::query` alike.
+    using css::for_each_word;
+    using css::AttributeMatch;
+    using css::AttributeSelector;
+    using css::Combinator;
+    using css::CompoundSelector;
+    using css::Selector;
+
+} // namespace termml::xml
+
+#endif // AMT_TERMML_XML_SELECTOR_HPP
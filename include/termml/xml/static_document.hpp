@@ -0,0 +1,506 @@
+#ifndef AMT_TERMML_XML_STATIC_DOCUMENT_HPP
+#define AMT_TERMML_XML_STATIC_DOCUMENT_HPP
+
+#include "node.hpp"
+#include "tag.hpp"
+#include "../core/string_utils.hpp"
+#include "../css/style.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Documents compiled from string literals at compile time:
+//
+//     static constexpr auto& doc = xml::static_document<R"(<col><text>Hi</text></col>)">;
+//     auto context = doc.instantiate();
+//
+// The tree, the resolved attributes and every element style are baked into static
+// tables, so instantiating does no lexing, parsing or style parsing; malformed
+// templates fail to compile.
+
+namespace termml::xml {
+
+    // String literal usable as a template argument.
+    template <std::size_t N>
+    struct FixedString {
+        char data[N]{};
+
+        consteval FixedString(char const (&s)[N]) noexcept {
+            std::copy_n(s, N, data);
+        }
+
+        constexpr auto view() const noexcept -> std::string_view {
+            return { data, N - 1 };
+        }
+    };
+
+    static constexpr auto static_null_index = std::numeric_limits<std::uint32_t>::max();
+
+    // Offset and size into the document's character table.
+    struct StaticString {
+        std::uint32_t offset{};
+        std::uint32_t size{};
+    };
+
+    struct StaticAttribute {
+        StaticString key{};
+        StaticString value{};
+    };
+
+    struct StaticElement {
+        StaticString tag{};
+        TagId tag_id{TagId::Unknown};
+        std::uint32_t parent{static_null_index};
+        std::uint32_t attribute_begin{};
+        std::uint32_t attribute_count{};
+        std::uint32_t child_begin{};
+        std::uint32_t child_count{};
+        std::uint32_t style_index{};
+        // `ElementNode::inherits`.
+        bool inherits{false};
+    };
+
+    struct StaticText {
+        StaticString text{};
+        std::uint32_t parent{};
+        std::uint32_t style_index{};
+    };
+
+    struct StaticCounts {
+        std::size_t elements{};
+        std::size_t attributes{};
+        std::size_t children{};
+        std::size_t texts{};
+        std::size_t chars{};
+    };
+
+    namespace detail {
+
+        // Growable form of a compiled template; only lives during constant evaluation.
+        struct TemplateTree {
+            std::vector<StaticElement> elements{};
+            std::vector<StaticAttribute> attributes{};
+            std::vector<Node> children{};
+            std::vector<StaticText> texts{};
+            std::vector<css::Style> styles{};
+            std::string chars{};
+
+            constexpr auto counts() const noexcept -> StaticCounts {
+                return {
+                    .elements = elements.size(),
+                    .attributes = attributes.size(),
+                    .children = children.size(),
+                    .texts = texts.size(),
+                    .chars = chars.size()
+                };
+            }
+
+            constexpr auto string(StaticString s) const noexcept -> std::string_view {
+                return std::string_view(chars).substr(s.offset, s.size);
+            }
+
+            constexpr auto add_string(std::string_view s) -> StaticString {
+                auto res = StaticString{
+                    .offset = static_cast<std::uint32_t>(chars.size()),
+                    .size = static_cast<std::uint32_t>(s.size())
+                };
+                chars.append(s);
+                return res;
+            }
+        };
+
+        // The key/value range `css::Style::parse_proprties` reads the attributes from.
+        struct TemplateProperties {
+            std::vector<std::pair<std::string_view, std::string_view>> items{};
+
+            constexpr auto begin() const {
+                return items.begin();
+            }
+
+            constexpr auto end() const {
+                return items.end();
+            }
+        };
+
+        // Follows the runtime lexer and parser: leading and trailing whitespace of the
+        // document and whitespace after "/>" are dropped, other whitespace between tags
+        // is kept as text, attribute values are trimmed and unescaped, character references
+        // in text are decoded, and children of void elements are dropped. Unlike
+        // the runtime parser it rejects malformed input, including malformed references,
+        // instead of recovering from it. `<style>` blocks are rejected.
+        struct TemplateParser {
+            std::string_view source;
+            TemplateTree tree{};
+
+            constexpr TemplateParser(std::string_view s) noexcept
+                : source(s)
+            {}
+
+            constexpr auto parse() -> void {
+                tree.elements.push_back({ .tag = tree.add_string("#root"), .tag_id = TagId::Root });
+                m_stack.push_back({ .element = 0 });
+
+                skip_whitespace();
+                while (m_cursor < source.size()) {
+                    auto rest = source.substr(m_cursor);
+                    if (rest.starts_with("<!--")) {
+                        auto end = source.find("-->", m_cursor + 4);
+                        ensure(end != std::string_view::npos, "unterminated comment");
+                        m_cursor = end + 3;
+                    } else if (rest.starts_with("</")) {
+                        parse_end_tag();
+                    } else if (rest.starts_with("<")) {
+                        parse_start_tag();
+                    } else {
+                        parse_text();
+                    }
+                }
+
+                ensure(m_stack.size() == 1, "unclosed element");
+                link_children();
+                compute_styles();
+            }
+
+        private:
+            struct Frame {
+                std::string_view tag{};
+                // `static_null_index` when the element was dropped.
+                std::uint32_t element{};
+                bool insert_children{true};
+            };
+
+            // Failing during constant evaluation is a compile error whose notes name the problem.
+            static constexpr auto ensure(bool ok, char const* what) -> void {
+                if (!ok) throw what;
+            }
+
+            constexpr auto is_eof() const noexcept -> bool {
+                return m_cursor >= source.size();
+            }
+
+            constexpr auto skip_whitespace() noexcept -> void {
+                while (!is_eof() && core::utils::is_space(source[m_cursor])) ++m_cursor;
+            }
+
+            static constexpr auto is_identifier(char c) noexcept -> bool {
+                return !(core::utils::is_space(c) || c == '=' || c == '/' || c == '>' || c == '<' || c == '"');
+            }
+
+            constexpr auto parse_identifier() noexcept -> std::string_view {
+                auto start = m_cursor;
+                while (!is_eof() && is_identifier(source[m_cursor])) ++m_cursor;
+                return source.substr(start, m_cursor - start);
+            }
+
+            constexpr auto parse_start_tag() -> void {
+                ++m_cursor;
+                auto tag = parse_identifier();
+                ensure(!tag.empty(), "expected a tag name after '<'");
+
+                auto const parent = m_stack.back();
+                auto tag_id = intern_tag(tag);
+                ensure(tag_id != TagId::Style, "<style> is not supported in compiled templates");
+                auto element = static_null_index;
+                if (parent.insert_children) {
+                    element = static_cast<std::uint32_t>(tree.elements.size());
+                    tree.elements.push_back({
+                        .tag = tree.add_string(tag),
+                        .tag_id = tag_id,
+                        .parent = parent.element,
+                        .attribute_begin = static_cast<std::uint32_t>(tree.attributes.size())
+                    });
+                    m_nodes.push_back({ .index = element, .kind = NodeKind::Element });
+                }
+
+                while (true) {
+                    skip_whitespace();
+                    ensure(!is_eof(), "unterminated start tag");
+
+                    if (source[m_cursor] == '>') {
+                        ++m_cursor;
+                        m_stack.push_back({
+                            .tag = tag,
+                            .element = element,
+                            .insert_children = parent.insert_children && !is_void_tag(tag_id)
+                        });
+                        return;
+                    }
+
+                    if (source.substr(m_cursor).starts_with("/>")) {
+                        // The lexer only keeps whitespace that follows a '>'.
+                        m_cursor += 2;
+                        skip_whitespace();
+                        return;
+                    }
+
+                    auto key = parse_identifier();
+                    ensure(!key.empty(), "unexpected character in start tag");
+
+                    auto value = std::string{};
+                    skip_whitespace();
+                    if (!is_eof() && source[m_cursor] == '=') {
+                        ++m_cursor;
+                        skip_whitespace();
+                        ensure(!is_eof() && source[m_cursor] == '"', "expected a quoted attribute value");
+                        value = unescape(parse_string());
+                    }
+
+                    if (element != static_null_index) set_attribute(element, key, value);
+                }
+            }
+
+            constexpr auto parse_end_tag() -> void {
+                m_cursor += 2;
+                auto tag = parse_identifier();
+                skip_whitespace();
+                ensure(!is_eof() && source[m_cursor] == '>', "unterminated end tag");
+                ++m_cursor;
+
+                ensure(m_stack.size() > 1, "end tag without a matching start tag");
+                ensure(m_stack.back().tag == tag, "end tag does not match the open element");
+                m_stack.pop_back();
+            }
+
+            // Returns the raw contents between the quotes.
+            constexpr auto parse_string() -> std::string_view {
+                auto start = ++m_cursor;
+                while (!is_eof() && source[m_cursor] != '"') {
+                    m_cursor += source[m_cursor] == '\\' ? 2 : 1;
+                }
+                ensure(!is_eof(), "unterminated attribute value");
+                return source.substr(start, m_cursor++ - start);
+            }
+
+            // Trims and unescapes like `Parser::compute_string`.
+            static constexpr auto unescape(std::string_view s) -> std::string {
+                auto res = std::string{};
+                core::utils::unescape(core::utils::trim(s), [&res](std::string_view piece) { res.append(piece); });
+                return res;
+            }
+
+            constexpr auto parse_text() -> void {
+                auto start = m_cursor;
+                while (!is_eof() && source[m_cursor] != '<') ++m_cursor;
+                auto text = source.substr(start, m_cursor - start);
+
+                // Trailing whitespace of the document.
+                if (is_eof() && core::utils::trim(text).empty()) return;
+
+                auto const parent = m_stack.back();
+                if (!parent.insert_children) return;
+
+                auto index = static_cast<std::uint32_t>(tree.texts.size());
+                tree.texts.push_back({ .text = tree.add_string(decode_references(text)), .parent = parent.element });
+                m_nodes.push_back({ .index = index, .kind = NodeKind::TextContent });
+            }
+
+            // Decodes like `Parser::parse_text`, but rejects a malformed reference.
+            static constexpr auto decode_references(std::string_view s) -> std::string {
+                auto res = std::string{};
+                auto invalid = core::utils::decode_references(s, [&res](std::string_view piece) { res.append(piece); });
+                ensure(invalid == std::string_view::npos, "invalid character reference");
+                return res;
+            }
+
+            // Later duplicates win, as they do in the runtime parser.
+            constexpr auto set_attribute(std::uint32_t element, std::string_view key, std::string_view value) -> void {
+                auto& el = tree.elements[element];
+                for (auto i = el.attribute_begin; i < el.attribute_begin + el.attribute_count; ++i) {
+                    auto& attr = tree.attributes[i];
+                    if (tree.string(attr.key) != key) continue;
+                    attr.value = tree.add_string(value);
+                    return;
+                }
+                auto k = tree.add_string(key);
+                auto v = tree.add_string(value);
+                tree.attributes.push_back({ .key = k, .value = v });
+                ++el.attribute_count;
+            }
+
+            constexpr auto parent_of(Node node) const noexcept -> std::uint32_t {
+                if (node.kind == NodeKind::Element) return tree.elements[node.index].parent;
+                return tree.texts[node.index].parent;
+            }
+
+            // Lays out every child list contiguously, in document order.
+            constexpr auto link_children() -> void {
+                for (auto n: m_nodes) ++tree.elements[parent_of(n)].child_count;
+
+                auto offset = std::uint32_t{};
+                for (auto& el: tree.elements) {
+                    el.child_begin = offset;
+                    offset += el.child_count;
+                }
+
+                tree.children.resize(m_nodes.size());
+                auto filled = std::vector<std::uint32_t>(tree.elements.size());
+                for (auto n: m_nodes) {
+                    auto p = parent_of(n);
+                    tree.children[tree.elements[p].child_begin + filled[p]++] = n;
+                }
+            }
+
+            // Same slots as `Context::build_style_tree`: elements in pre-order, each followed
+            // by its text children.
+            constexpr auto compute_styles() -> void {
+                auto stack = std::vector<std::uint32_t>{ 0 };
+                while (!stack.empty()) {
+                    auto& el = tree.elements[stack.back()];
+                    stack.pop_back();
+
+                    auto style = css::Style{};
+                    if (el.parent == static_null_index) {
+                        style.width = { .f = 100, .unit = css::Unit::Percentage };
+                        style.height = { .f = 100, .unit = css::Unit::Percentage };
+                    } else {
+                        auto props = TemplateProperties{};
+                        for (auto i = el.attribute_begin; i < el.attribute_begin + el.attribute_count; ++i) {
+                            auto const& attr = tree.attributes[i];
+                            auto key = tree.string(attr.key);
+                            auto value = tree.string(attr.value);
+                            el.inherits = el.inherits || css::is_inherit(key, value);
+                            props.items.emplace_back(key, value);
+                        }
+                        auto parent_style = tree.styles[tree.elements[el.parent].style_index];
+                        style.parse_proprties(el.tag_id, props, &parent_style);
+                    }
+                    el.style_index = static_cast<std::uint32_t>(tree.styles.size());
+                    tree.styles.push_back(style);
+
+                    for (auto i = 0u; i < el.child_count; ++i) {
+                        auto c = tree.children[el.child_begin + i];
+                        if (c.kind != NodeKind::TextContent) continue;
+                        tree.texts[c.index].style_index = static_cast<std::uint32_t>(tree.styles.size());
+                        tree.styles.emplace_back();
+                    }
+                    for (auto i = el.child_count; i > 0; --i) {
+                        auto c = tree.children[el.child_begin + i - 1];
+                        if (c.kind == NodeKind::Element) stack.push_back(static_cast<std::uint32_t>(c.index));
+                    }
+                }
+            }
+
+        private:
+            std::size_t m_cursor{};
+            std::vector<Frame> m_stack{};
+            // Every inserted node in document order.
+            std::vector<Node> m_nodes{};
+        };
+
+        constexpr auto compile_template(std::string_view source) -> TemplateTree {
+            auto parser = TemplateParser(source);
+            parser.parse();
+            return std::move(parser.tree);
+        }
+
+        struct StaticTables {
+            std::span<StaticElement const> elements;
+            std::span<StaticAttribute const> attributes;
+            std::span<Node const> children;
+            std::span<StaticText const> texts;
+            std::span<css::Style const> styles;
+            std::string_view chars;
+
+            constexpr auto string(StaticString s) const noexcept -> std::string_view {
+                return chars.substr(s.offset, s.size);
+            }
+        };
+
+        inline auto instantiate(StaticTables const& t, std::string_view name) -> std::unique_ptr<Context> {
+            auto context = std::make_unique<Context>(Lexer(std::string_view{}, name));
+            auto& c = *context;
+
+            c.element_nodes.reserve(t.elements.size());
+            for (auto const& record: t.elements) {
+                auto el = c.make_element(t.string(record.tag));
+                el.parent = record.parent == static_null_index ? invalid_index : record.parent;
+                el.style_index = record.style_index;
+                el.inherits = record.inherits;
+
+                el.attributes.reserve(record.attribute_count);
+                for (auto const& attr: t.attributes.subspan(record.attribute_begin, record.attribute_count)) {
+                    el.attributes.emplace(t.string(attr.key), t.string(attr.value));
+                }
+
+                auto children = t.children.subspan(record.child_begin, record.child_count);
+                el.childern.assign(children.begin(), children.end());
+                c.element_nodes.push_back(std::move(el));
+            }
+
+            c.text_nodes.reserve(t.texts.size());
+            for (auto const& record: t.texts) {
+                c.text_nodes.push_back({
+                    .token_index = 0,
+                    .text = t.string(record.text),
+                    .style_index = record.style_index,
+                    .parent = record.parent
+                });
+            }
+
+            c.styles.assign(t.styles.begin(), t.styles.end());
+            c.rebuild_indexes();
+            c.resolve_text();
+            return context;
+        }
+
+    } // namespace detail
+
+    // Flat, immutable tables of a compiled template.
+    template <StaticCounts Counts>
+    struct StaticDocument {
+        std::array<StaticElement, Counts.elements> elements{};
+        std::array<StaticAttribute, Counts.attributes> attributes{};
+        std::array<Node, Counts.children> children{};
+        std::array<StaticText, Counts.texts> texts{};
+        std::array<css::Style, Counts.elements + Counts.texts> styles{};
+        std::array<char, Counts.chars> chars{};
+
+        constexpr auto string(StaticString s) const noexcept -> std::string_view {
+            return { chars.data() + s.offset, s.size };
+        }
+
+        // Builds a context whose strings point into the static tables. Styles are copied
+        // and only whitespace collapsing runs, so the context supports the mutation API.
+        auto instantiate(std::string_view name = "<template>") const -> std::unique_ptr<Context> {
+            return detail::instantiate({
+                .elements = elements,
+                .attributes = attributes,
+                .children = children,
+                .texts = texts,
+                .styles = styles,
+                .chars = std::string_view(chars.data(), chars.size())
+            }, name);
+        }
+    };
+
+    // Table sizes of a template; the tables are then filled by a second compilation.
+    template <FixedString Source>
+    inline constexpr auto static_counts = detail::compile_template(Source.view()).counts();
+
+    template <FixedString Source>
+    consteval auto compile_document() {
+        auto tree = detail::compile_template(Source.view());
+
+        auto doc = StaticDocument<static_counts<Source>>{};
+        std::copy(tree.elements.begin(), tree.elements.end(), doc.elements.begin());
+        std::copy(tree.attributes.begin(), tree.attributes.end(), doc.attributes.begin());
+        std::copy(tree.children.begin(), tree.children.end(), doc.children.begin());
+        std::copy(tree.texts.begin(), tree.texts.end(), doc.texts.begin());
+        std::copy(tree.styles.begin(), tree.styles.end(), doc.styles.begin());
+        std::copy(tree.chars.begin(), tree.chars.end(), doc.chars.begin());
+        return doc;
+    }
+
+    template <FixedString Source>
+    inline constexpr auto static_document = compile_document<Source>();
+
+} // namespace termml::xml
+
+#endif // AMT_TERMML_XML_STATIC_DOCUMENT_HPP
@@ -0,0 +1,15 @@
+#ifndef AMT_TERMML_XML_TAG_HPP
+#define AMT_TERMML_XML_TAG_HPP
+
+#include "../core/tag.hpp"
+
+namespace termml::xml {
+
+    // Tags live in core so that css can name them without depending on xml.
+    using core::TagId;
+    using core::intern_tag;
+    using core::is_void_tag;
+
+} // namespace termml::xml
+
+#endif // AMT_TERMML_XML_TAG_HPP
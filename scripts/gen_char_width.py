@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+"""Generates include/termml/core/char_width_table.hpp from the Unicode data
+that ships with Python's unicodedata module.
+
+Widths of codepoints from U+0080 on:
+    0  nonspacing and enclosing marks, format characters except U+00AD, C1
+       controls, and Hangul medial vowels and final consonants
+    2  East Asian Wide and Fullwidth characters
+    1  everything else
+
+Usage: scripts/gen_char_width.py > include/termml/core/char_width_table.hpp
+"""
+
+import unicodedata
+
+BLOCK_BITS = 8
+BLOCK = 1 << BLOCK_BITS
+MAX_CODEPOINT = 0x10FFFF
+
+
+def width(cp: int) -> int:
+    if cp < 0x80:
+        return 1
+    c = chr(cp)
+    cat = unicodedata.category(c)
+    if cp == 0x00AD:
+        return 1
+    if cat in ("Mn", "Me", "Cf", "Cc"):
+        return 0
+    if 0x1160 <= cp <= 0x11FF or 0xD7B0 <= cp <= 0xD7FF:
+        return 0
+    if unicodedata.east_asian_width(c) in ("W", "F"):
+        return 2
+    return 1
+
+
+def main() -> None:
+    blocks = []
+    block_index = {}
+    stage1 = []
+    for b in range((MAX_CODEPOINT + 1) // BLOCK):
+        widths = [width(b * BLOCK + i) for i in range(BLOCK)]
+        packed = []
+        for i in range(0, BLOCK, 4):
+            packed.append(widths[i] | widths[i + 1] << 2 | widths[i + 2] << 4 | widths[i + 3] << 6)
+        key = tuple(packed)
+        if key not in block_index:
+            block_index[key] = len(blocks)
+            blocks.append(key)
+        stage1.append(block_index[key])
+
+    assert len(blocks) <= 256
+
+    def rows(values, per_row):
+        for i in range(0, len(values), per_row):
+            yield "        " + ", ".join(f"0x{v:02x}" for v in values[i:i + per_row]) + ","
+
+    out = []
+    out.append("#ifndef AMT_TERMML_CORE_CHAR_WIDTH_TABLE_HPP")
+    out.append("#define AMT_TERMML_CORE_CHAR_WIDTH_TABLE_HPP")
+    out.append("")
+    out.append(f"// Generated by scripts/gen_char_width.py from Unicode {unicodedata.unidata_version}. Do not edit.")
+    out.append("")
+    out.append("#include <array>")
+    out.append("#include <cstdint>")
+    out.append("")
+    out.append("namespace termml::core::unicode::detail {")
+    out.append(f"    inline constexpr auto width_block_bits = {BLOCK_BITS}u;")
+    out.append("")
+    out.append("    // Block of every 256 codepoints in `width_blocks`.")
+    out.append(f"    inline constexpr std::array<std::uint8_t, {len(stage1)}> width_stage1 {{")
+    out.extend(rows(stage1, 16))
+    out.append("    };")
+    out.append("")
+    out.append("    // Distinct blocks, four 2-bit widths per byte starting at the low bits.")
+    out.append(f"    inline constexpr std::array<std::uint8_t, {len(blocks) * BLOCK // 4}> width_blocks {{")
+    for b in blocks:
+        out.extend(rows(list(b), 16))
+    out.append("    };")
+    out.append("} // namespace termml::core::unicode::detail")
+    out.append("")
+    out.append("#endif // AMT_TERMML_CORE_CHAR_WIDTH_TABLE_HPP")
+    print("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,124 @@
+#include <catch2/catch_test_macros.hpp>
+#include "termml.hpp"
+#include "termml/xml/binary.hpp"
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace termml;
+
+namespace {
+
+    constexpr std::string_view source = R"xml(
+        <style>.warn { color: yellow; } col > p { padding-left: 1c; }</style>
+        <col border="thin solid" padding="1c" color="green">
+            <row><b>Status</b> <text id="status" class="warn">starting</text></row>
+            <p class="warn" color="inherit">first <i>entry</i></p>
+            <p>second   entry with    spaces</p>
+            <col virtual-rows="1"><p>a</p><p>b</p></col>
+        </col>
+    )xml";
+
+    auto parse(std::string_view text) -> std::unique_ptr<xml::Context> {
+        auto l = xml::Lexer(text, "binary_test");
+        l.lex();
+        auto parser = xml::Parser(std::move(l));
+        parser.parse();
+        return std::move(parser.context);
+    }
+
+    auto load(std::string const& blob) -> std::unique_ptr<xml::Context> {
+        return xml::binary::load(std::as_bytes(std::span(blob)));
+    }
+
+    auto render(xml::Context* context) -> std::string {
+        auto layout = layout::LayoutContext({ .x = 0, .y = 0, .width = 40, .height = 20 });
+        layout.compute(context);
+        auto terminal = core::Terminal(40, 20);
+        auto device = core::Device(&terminal);
+        layout.render(device, context);
+
+        auto out = std::string{};
+        for (auto r = 0u; r < 20; ++r) {
+            for (auto c = 0u; c < 40; ++c) {
+                auto text = terminal(r, c).text();
+                out += text.empty() ? std::string_view(" ") : text;
+            }
+            out += '\n';
+        }
+        return out;
+    }
+
+} // namespace
+
+TEST_CASE("binary documents round-trip", "[binary]") {
+    auto context = parse(source);
+    auto const blob = xml::binary::serialize(*context);
+    auto loaded = load(blob);
+
+    SECTION("nodes and styles are restored") {
+        REQUIRE(loaded->element_nodes.size() == context->element_nodes.size());
+        REQUIRE(loaded->text_nodes.size() == context->text_nodes.size());
+        for (auto i = 0ul; i < context->element_nodes.size(); ++i) {
+            auto const& lhs = context->element_nodes[i];
+            auto const& rhs = loaded->element_nodes[i];
+            REQUIRE(lhs.tag == rhs.tag);
+            REQUIRE(lhs.parent == rhs.parent);
+            REQUIRE(lhs.style_index == rhs.style_index);
+            REQUIRE(lhs.attributes == rhs.attributes);
+            REQUIRE(lhs.childern.size() == rhs.childern.size());
+        }
+        for (auto i = 0ul; i < context->text_nodes.size(); ++i) {
+            REQUIRE(context->text_nodes[i].text == loaded->text_nodes[i].text);
+            REQUIRE(context->text_nodes[i].normalized_text == loaded->text_nodes[i].normalized_text);
+        }
+        REQUIRE(context->styles.size() == loaded->styles.size());
+        REQUIRE(std::memcmp(context->styles.data(), loaded->styles.data(), context->styles.size() * sizeof(css::Style)) == 0);
+    }
+
+    SECTION("a loaded document saves and loads again") {
+        // Loading views the blob, so it has to outlive the context.
+        auto const second = xml::binary::serialize(*loaded);
+        auto again = load(second);
+        REQUIRE(again->element_nodes.size() == context->element_nodes.size());
+        REQUIRE(render(again.get()) == render(context.get()));
+    }
+
+    SECTION("a loaded document renders and queries like the original") {
+        REQUIRE(render(loaded.get()) == render(context.get()));
+        REQUIRE(loaded->query_all(".warn").size() == context->query_all(".warn").size());
+        REQUIRE(loaded->query("#status") == context->query("#status"));
+    }
+
+    SECTION("a loaded document can be mutated") {
+        auto status = loaded->query("#status");
+        REQUIRE(status != xml::invalid_index);
+        loaded->set_attribute(status, "class", "");
+        context->set_attribute(context->query("#status"), "class", "");
+        REQUIRE(render(loaded.get()) == render(context.get()));
+    }
+}
+
+TEST_CASE("binary documents from another build are rejected", "[binary]") {
+    auto context = parse(source);
+    auto blob = xml::binary::serialize(*context);
+
+    SECTION("bad magic") {
+        blob[0] = 'X';
+        REQUIRE_THROWS_AS(load(blob), std::runtime_error);
+    }
+
+    SECTION("another version") {
+        auto const version = xml::binary::version + 1;
+        std::memcpy(blob.data() + offsetof(xml::binary::Header, version), &version, sizeof(version));
+        REQUIRE_THROWS_AS(load(blob), std::runtime_error);
+    }
+
+    SECTION("truncated") {
+        blob.resize(sizeof(xml::binary::Header) - 1);
+        REQUIRE_THROWS_AS(load(blob), std::runtime_error);
+    }
+}
@@ -0,0 +1,162 @@
+#include <catch2/catch_test_macros.hpp>
+#include "termml.hpp"
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace termml;
+
+namespace {
+
+    constexpr auto width = 50;
+    constexpr auto height = 120;
+
+    auto make_source() -> std::string {
+        auto source = std::string(R"xml(
+            <style>.warn { color: yellow; } .wide { padding: 1c; } col > .note { padding-left: 2c; }</style>
+            <col id="top" color="green" white-space="pre-line">
+                <p id="first">a short first paragraph</p>
+        )xml");
+        for (auto i = 0; i < 20; ++i) {
+            source += i % 5 == 4 ? R"xml(<col class="wide" border="thin solid">)xml" : R"xml(<col>)xml";
+            source += R"xml(<p class="note" color="inherit">note )xml";
+            source += std::to_string(i);
+            source += " with <b>bold</b> words that wrap onto a second line</p><text>tail</text></col>";
+        }
+        source += "</col>";
+        return source;
+    }
+
+    auto parse(std::string_view text) -> std::unique_ptr<xml::Context> {
+        auto l = xml::Lexer(text, "incremental_layout_test");
+        l.lex();
+        auto parser = xml::Parser(std::move(l));
+        parser.parse();
+        return std::move(parser.context);
+    }
+
+    auto render(layout::LayoutContext& layout, xml::Context* context) -> std::string {
+        auto terminal = core::Terminal(width, height);
+        auto device = core::Device(&terminal);
+        layout.render(device, context);
+
+        auto out = std::string{};
+        for (auto r = 0u; r < height; ++r) {
+            for (auto c = 0u; c < width; ++c) {
+                auto text = terminal(r, c).text();
+                out += text.empty() ? std::string_view(" ") : text;
+            }
+            out += '\n';
+        }
+        return out;
+    }
+
+    // Lays out `incremental` again after `mutate`, and a copy of the document that was
+    // never styled or laid out after the same `mutate`, and requires the same result.
+    auto require_same_as_fresh(std::function<void(xml::Context&)> const& mutate) -> void {
+        auto const source = make_source();
+        auto incremental = parse(source);
+        auto layout = layout::LayoutContext({ .x = 0, .y = 0, .width = width, .height = height });
+        layout.compute(incremental.get());
+
+        auto fresh = parse(source);
+        mutate(*incremental);
+        mutate(*fresh);
+        incremental->resolve_css();
+        fresh->resolve_css();
+
+        REQUIRE(incremental->element_nodes.size() == fresh->element_nodes.size());
+        for (auto i = 0ul; i < fresh->element_nodes.size(); ++i) {
+            auto const& lhs = incremental->element_nodes[i];
+            auto const& rhs = fresh->element_nodes[i];
+            REQUIRE(lhs.parent == rhs.parent);
+            if (!fresh->is_attached(i)) continue;
+            CAPTURE(i, lhs.tag);
+            REQUIRE(std::memcmp(&incremental->styles[lhs.style_index], &fresh->styles[rhs.style_index], sizeof(css::Style)) == 0);
+        }
+        for (auto i = 0ul; i < fresh->text_nodes.size(); ++i) {
+            auto const parent = fresh->text_nodes[i].parent;
+            if (parent == xml::invalid_index || !fresh->is_attached(parent)) continue;
+            REQUIRE(incremental->text_nodes[i].normalized_text == fresh->text_nodes[i].normalized_text);
+        }
+
+        layout.compute(incremental.get());
+        auto fresh_layout = layout::LayoutContext({ .x = 0, .y = 0, .width = width, .height = height });
+        fresh_layout.compute(fresh.get());
+
+        // An incremental layout keeps the nodes of removed elements, so the trees are
+        // compared from the root.
+        auto stack = std::vector<std::pair<std::size_t, std::size_t>>{ { 0, 0 } };
+        while (!stack.empty()) {
+            auto const [lhs, rhs] = stack.back();
+            stack.pop_back();
+            CAPTURE(lhs, rhs);
+            REQUIRE(layout.nodes[lhs].container == fresh_layout.nodes[rhs].container);
+            REQUIRE(layout.nodes[lhs].lines.start == fresh_layout.nodes[rhs].lines.start);
+            REQUIRE(layout.nodes[lhs].lines.size == fresh_layout.nodes[rhs].lines.size);
+            auto const lhs_kids = layout.children_of(lhs);
+            auto const rhs_kids = fresh_layout.children_of(rhs);
+            REQUIRE(lhs_kids.size() == rhs_kids.size());
+            for (auto i = 0ul; i < lhs_kids.size(); ++i) stack.emplace_back(lhs_kids[i], rhs_kids[i]);
+        }
+        REQUIRE(layout.lines.size() == fresh_layout.lines.size());
+        for (auto i = 0ul; i < fresh_layout.lines.size(); ++i) {
+            CAPTURE(i);
+            REQUIRE(layout.lines[i].line == fresh_layout.lines[i].line);
+            REQUIRE(layout.lines[i].bounds == fresh_layout.lines[i].bounds);
+        }
+        REQUIRE(render(layout, incremental.get()) == render(fresh_layout, fresh.get()));
+    }
+
+    auto first_text(xml::Context& context, std::string_view selector) -> xml::node_index_t {
+        return context.element_nodes[context.query(selector)].childern[0].index;
+    }
+
+} // namespace
+
+TEST_CASE("incremental layout matches a fresh one", "[layout]") {
+    SECTION("a text growing by a line moves everything below it") {
+        require_same_as_fresh([](xml::Context& c) {
+            c.set_text(first_text(c, "#first"), "a first paragraph that is now long enough to need a second line");
+        });
+    }
+
+    SECTION("a text shrinking by a line moves everything below it") {
+        require_same_as_fresh([](xml::Context& c) {
+            c.set_text(first_text(c, "#first"), "short");
+            c.set_text(first_text(c, ".note"), "short");
+        });
+    }
+
+    SECTION("a class change restyles the matched elements") {
+        require_same_as_fresh([](xml::Context& c) {
+            auto const notes = c.query_all(".note");
+            c.set_attribute(notes[3], "class", "warn");
+            c.set_attribute(notes[8], "class", "note wide");
+        });
+    }
+
+    SECTION("an inherited property changes on an ancestor") {
+        require_same_as_fresh([](xml::Context& c) {
+            c.set_attribute(c.query("#top"), "color", "red");
+            c.set_attribute(c.query("#top"), "white-space", "normal");
+        });
+    }
+
+    SECTION("elements are added and removed") {
+        require_same_as_fresh([](xml::Context& c) {
+            auto const top = c.query("#top");
+            auto const p = c.create_element("p");
+            c.append_child(p, { .index = c.create_text("an added paragraph"), .kind = xml::NodeKind::TextContent });
+            c.append_child(top, { .index = p, .kind = xml::NodeKind::Element });
+
+            auto const notes = c.query_all(".note");
+            auto const parent = c.element_nodes[notes[4]].parent;
+            c.remove_child(parent, { .index = notes[4], .kind = xml::NodeKind::Element });
+        });
+    }
+}
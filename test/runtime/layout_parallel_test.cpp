@@ -0,0 +1,118 @@
+#include <catch2/catch_test_macros.hpp>
+#include "termml.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+
+using namespace termml;
+
+namespace {
+
+    constexpr auto width = 60;
+    constexpr auto height = 200;
+
+    auto make_source() -> std::string {
+        auto source = std::string(R"xml(<style>.box { padding: 1c; } .warn { color: yellow; }</style>)xml");
+        for (auto i = 0; i < 12; ++i) {
+            source += i % 4 == 3 ? R"xml(<col class="box" border="thin solid">)xml" : R"xml(<col class="box">)xml";
+            for (auto j = 0; j < 6; ++j) {
+                source += R"xml(<p class="warn">entry )xml";
+                source += std::to_string(i * 6 + j);
+                source += " with <b>bold</b> text long enough to wrap onto the next line of the box</p>";
+            }
+            if (i == 5) source += R"xml(<col virtual-rows="1" height="3c"><p>a</p><p>b</p><p>c</p><p>d</p></col>)xml";
+            source += "</col>";
+            // Inline content between blocks keeps the next block from being forked.
+            if (i == 8) source += "<text>between</text>";
+        }
+        return source;
+    }
+
+    auto parse(std::string_view text) -> std::unique_ptr<xml::Context> {
+        auto l = xml::Lexer(text, "layout_parallel_test");
+        l.lex();
+        auto parser = xml::Parser(std::move(l));
+        parser.parse();
+        return std::move(parser.context);
+    }
+
+    auto render(layout::LayoutContext& layout, xml::Context* context) -> std::string {
+        auto terminal = core::Terminal(width, height);
+        auto device = core::Device(&terminal);
+        layout.render(device, context);
+
+        auto out = std::string{};
+        for (auto r = 0u; r < height; ++r) {
+            for (auto c = 0u; c < width; ++c) {
+                auto text = terminal(r, c).text();
+                out += text.empty() ? std::string_view(" ") : text;
+            }
+            out += '\n';
+        }
+        return out;
+    }
+
+    auto require_equal(layout::LayoutContext& expected, xml::Context* expected_context, layout::LayoutContext& actual, xml::Context* actual_context) -> void {
+        REQUIRE(actual.nodes.size() == expected.nodes.size());
+        for (auto i = 0ul; i < expected.nodes.size(); ++i) {
+            auto const& lhs = expected.nodes[i];
+            auto const& rhs = actual.nodes[i];
+            REQUIRE(lhs.kind == rhs.kind);
+            REQUIRE(lhs.container == rhs.container);
+            REQUIRE(lhs.lines.start == rhs.lines.start);
+            REQUIRE(lhs.lines.size == rhs.lines.size);
+        }
+
+        REQUIRE(actual.lines.size() == expected.lines.size());
+        for (auto i = 0ul; i < expected.lines.size(); ++i) {
+            REQUIRE(expected.lines[i].line == actual.lines[i].line);
+            REQUIRE(expected.lines[i].bounds == actual.lines[i].bounds);
+        }
+        REQUIRE(render(actual, actual_context) == render(expected, expected_context));
+    }
+
+} // namespace
+
+TEST_CASE("parallel layout matches a layout on one thread", "[layout]") {
+    auto const source = make_source();
+    auto sequential_context = parse(source);
+    auto parallel_context = parse(source);
+
+    auto sequential = layout::LayoutContext({ .x = 0, .y = 0, .width = width, .height = height });
+    auto parallel = layout::LayoutContext({ .x = 0, .y = 0, .width = width, .height = height });
+    sequential.parallel = { .threads = 1, .min_subtree_nodes = 4 };
+    parallel.parallel = { .threads = 4, .min_subtree_nodes = 4 };
+
+    auto compute = [&] {
+        sequential.compute(sequential_context.get());
+        parallel.compute(parallel_context.get());
+        require_equal(sequential, sequential_context.get(), parallel, parallel_context.get());
+    };
+
+    SECTION("a fresh layout") {
+        compute();
+    }
+
+    SECTION("after the viewport narrows") {
+        compute();
+        sequential.viewport.width = parallel.viewport.width = width - 17;
+        compute();
+    }
+
+    SECTION("after a text in one block changes") {
+        compute();
+        for (auto* context: { sequential_context.get(), parallel_context.get() }) {
+            auto const p = context->query_all("p")[7];
+            context->set_text(context->element_nodes[p].childern[0].index, "a much longer entry that now takes several lines in its box instead of two");
+        }
+        compute();
+    }
+
+    SECTION("after a class changes everywhere") {
+        compute();
+        for (auto* context: { sequential_context.get(), parallel_context.get() }) {
+            for (auto col: context->query_all(".box")) context->set_attribute(col, "class", "");
+        }
+        compute();
+    }
+}
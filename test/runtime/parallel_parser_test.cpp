@@ -0,0 +1,138 @@
+#include <catch2/catch_test_macros.hpp>
+#include "termml.hpp"
+#include "termml/xml/parallel_parser.hpp"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+using namespace termml;
+
+namespace {
+
+    auto make_source() -> std::string {
+        auto source = std::string(R"xml(
+            <style>.warn { color: yellow; } col > p { padding-left: 1c; }</style>
+            top text <b>bold</b>
+            <img src="a>b"/>   <row title="q\"<x>" class="x y">r &amp; s</row></stray>
+        )xml");
+        for (auto i = 0; i < 24; ++i) {
+            source += i % 3 == 0 ? R"xml(<col class="warn" id="c)xml" : R"xml(<col class="ok" id="c)xml";
+            source += std::to_string(i % 20);
+            source += R"xml("><p color="inherit">entry &#65; )xml";
+            source += std::to_string(i);
+            source += "</p> <!-- a comment --> <text>tail</text></col>\n";
+        }
+        source += R"xml(<style>.ok { color: green; }</style>  <col><col><text>deep</text></col></col>   tail   )xml";
+        return source;
+    }
+
+    auto parse(std::string_view text) -> std::unique_ptr<xml::Context> {
+        auto l = xml::Lexer(text, "parallel_parser_test");
+        l.lex();
+        auto parser = xml::Parser(std::move(l));
+        parser.parse();
+        return std::move(parser.context);
+    }
+
+    auto sorted_attributes(xml::ElementNode const& el) {
+        auto res = std::vector<std::pair<std::string_view, std::string_view>>(el.attributes.begin(), el.attributes.end());
+        std::ranges::sort(res);
+        return res;
+    }
+
+    auto render(xml::Context* context) -> std::string {
+        auto layout = layout::LayoutContext({ .x = 0, .y = 0, .width = 40, .height = 60 });
+        layout.compute(context);
+        auto terminal = core::Terminal(40, 60);
+        auto device = core::Device(&terminal);
+        layout.render(device, context);
+
+        auto out = std::string{};
+        for (auto r = 0u; r < 60; ++r) {
+            for (auto c = 0u; c < 40; ++c) {
+                auto text = terminal(r, c).text();
+                out += text.empty() ? std::string_view(" ") : text;
+            }
+            out += '\n';
+        }
+        return out;
+    }
+
+    auto require_equal(xml::Context& expected, xml::Context& actual) -> void {
+        expected.resolve_css();
+        actual.resolve_css();
+
+        REQUIRE(actual.element_nodes.size() == expected.element_nodes.size());
+        for (auto i = 0ul; i < expected.element_nodes.size(); ++i) {
+            auto const& lhs = expected.element_nodes[i];
+            auto const& rhs = actual.element_nodes[i];
+            REQUIRE(lhs.tag == rhs.tag);
+            REQUIRE(lhs.parent == rhs.parent);
+            REQUIRE(lhs.inherits == rhs.inherits);
+            REQUIRE(sorted_attributes(lhs) == sorted_attributes(rhs));
+            REQUIRE(std::ranges::equal(lhs.childern, rhs.childern, [](auto a, auto b) {
+                return a.index == b.index && a.kind == b.kind;
+            }));
+            REQUIRE(std::memcmp(&expected.styles[lhs.style_index], &actual.styles[rhs.style_index], sizeof(css::Style)) == 0);
+        }
+
+        REQUIRE(actual.text_nodes.size() == expected.text_nodes.size());
+        for (auto i = 0ul; i < expected.text_nodes.size(); ++i) {
+            REQUIRE(expected.text_nodes[i].text == actual.text_nodes[i].text);
+            REQUIRE(expected.text_nodes[i].normalized_text == actual.text_nodes[i].normalized_text);
+            REQUIRE(expected.text_nodes[i].parent == actual.text_nodes[i].parent);
+        }
+
+        for (auto selector: { "#c0", "#c7", "#c19", ".warn", ".ok", ".x", "col > p", "text" }) {
+            REQUIRE(actual.query(selector) == expected.query(selector));
+            REQUIRE(actual.query_all(selector) == expected.query_all(selector));
+        }
+        REQUIRE(render(&actual) == render(&expected));
+    }
+
+} // namespace
+
+TEST_CASE("parallel parsing matches a sequential parse", "[parallel_parser]") {
+    auto const source = make_source();
+    auto expected = parse(source);
+
+    for (auto threads: { 2ul, 3ul, 8ul }) {
+        for (auto segment_size: { 1ul, 64ul, 512ul }) {
+            CAPTURE(threads, segment_size);
+            auto actual = xml::parse_parallel(xml::Lexer(source, "parallel_parser_test"), {
+                .threads = threads,
+                .min_segment_size = segment_size
+            });
+            require_equal(*expected, *actual);
+        }
+    }
+}
+
+TEST_CASE("parallel parsing reuses the threads of a pool", "[parallel_parser]") {
+    auto const source = make_source();
+    auto expected = parse(source);
+    auto pool = core::ThreadPool{};
+
+    for (auto i = 0; i < 3; ++i) {
+        auto actual = xml::parse_parallel(pool, xml::Lexer(source, "parallel_parser_test"), { .threads = 4, .min_segment_size = 64 });
+        require_equal(*expected, *actual);
+        REQUIRE(pool.size() == 3);
+    }
+}
+
+TEST_CASE("a pool rethrows the first failure and stays usable", "[parallel_parser]") {
+    auto pool = core::ThreadPool{};
+    REQUIRE_THROWS_AS(pool.run(4, [](std::size_t worker) {
+        if (worker == 2) throw std::runtime_error("worker failed");
+    }), std::runtime_error);
+
+    auto const source = make_source();
+    auto expected = parse(source);
+    auto actual = xml::parse_parallel(pool, xml::Lexer(source, "parallel_parser_test"), { .threads = 4, .min_segment_size = 64 });
+    require_equal(*expected, *actual);
+}